@@ -7,17 +7,47 @@
 Кадр = type(1B) + length(4B BE) + payload
 - HELLO(0x01): payload = username (utf-8)
 - MSG(0x02)  : payload = text (utf-8)
+- DM(0x03)   : payload = tolen(2BE) + to(tolen) + text — личное сообщение
+- MSG_DIRECT(0x13):
+    payload = ts_ms(8BE) + flen(2BE) + from(flen) + tolen(2BE) + to(tolen) + mlen(4BE) + message(mlen)
 - OK(0x06) / ERR(0x05)
+- PING(0x07) / PONG(0x08): сервер шлёт PING простаивающим клиентам, клиент отвечает PONG
 - MSG_BROADCAST(0x12):
-    payload = ts_ms(8BE) + ulen(2BE) + username(ulen) + mlen(4BE) + message(mlen)
+    payload = ts_ms(8BE) + ulen(2BE) + username(ulen) + mlen(4BE) + message(mlen) [+ seq(8BE)]
+  HELLO может нести RESUME: username + 0x00 + 0x01 + len(2BE)=8 + last_seq(8BE),
+  тогда сервер вместо истории присылает только сообщения с seq > last_seq
+- Вложения (id = sha256 содержимого, hex):
+    ATTACH_BEGIN(0x0B): id(str16) + size(8BE)  -> ATTACH_ACK(0x0C): id(str16) + have(8BE)
+    ATTACH_CHUNK(0x0D): id(str16) + size(8BE) + offset(8BE) + данные; последний кусок -> ATTACH_ACK
+    MSG_ATTACH(0x0E):   id(str16) + name(str16) + подпись — сервер рассылает обычный MSG_BROADCAST
+                        с текстом "attach:<id>:<size>:<name>" [+ "\n" + подпись]
+    BLOB_GET(0x0F):     id(str16) + offset(8BE) -> BLOB_DATA(0x10): id(str16) + offset(8BE) + данные
+- Multicast (--mcast): HELLO + 0x00 + 0x02 + len(2BE)=0. Если у сервера включён multicast,
+  после OK приходит MCAST_INFO(0x14): group(str16) + port(2BE), и MSG_BROADCAST идут
+  UDP-датаграммами в группу (тот же кадр). Раз в секунду в группу идёт MCAST_TAIL(0x15): seq(8BE).
+  Пропуски добираются по TCP: GAP_FETCH(0x11): after_seq(8BE) + count(2BE).
+- Локально (--unix PATH [--shm]): тот же протокол по Unix-сокету. С HELLO-расширением SHM (0x03, len=0)
+  сервер присылает SHM_INFO(0x16): capacity(8BE) с memfd и eventfd в SCM_RIGHTS, и дальше все кадры
+  сервера идут через кольцо в общей памяти (разметка — server/src/net/shm_ring.hpp), а кадры клиента — в сокет.
+- При лавине входов сервер вместо OK может ответить BUSY(0x17): retry_after_ms(4BE) + причина (utf-8).
+  Клиент переподключается через retry_after со случайной добавкой до 50%.
 
 Запуск:
-  python client.py --host 127.0.0.1 --port 5555 --user Alice
+  python client.py --host 127.0.0.1 --port 5555 --user Alice [--mcast [--mcast-if 127.0.0.1]]
+  python client.py --unix data/lanchat.sock --shm --user Bot
 Команды:
+  /dm <user> <текст> — личное сообщение
+  /send <путь> [подпись] — отправить файл вложением
+  /get <id> — скачать вложение в текущую папку
   /quit — выйти
 """
 
 import argparse
+import hashlib
+import mmap
+import os
+import random
+import select
 import socket
 import struct
 import sys
@@ -28,12 +58,37 @@ from datetime import datetime
 # Типы кадров
 HELLO = 0x01
 MSG   = 0x02
+DM    = 0x03
 ERR   = 0x05
 OK    = 0x06
+PING  = 0x07
+PONG  = 0x08
+ATTACH_BEGIN = 0x0B
+ATTACH_ACK   = 0x0C
+ATTACH_CHUNK = 0x0D
+MSG_ATTACH   = 0x0E
+BLOB_GET     = 0x0F
+BLOB_DATA    = 0x10
+GAP_FETCH    = 0x11
 MSG_BROADCAST = 0x12
+MSG_DIRECT    = 0x13
+MCAST_INFO    = 0x14
+MCAST_TAIL    = 0x15
+
+SHM_INFO      = 0x16
+BUSY          = 0x17
+
+HELLO_EXT_MCAST = 0x02
+HELLO_EXT_SHM   = 0x03
+GAP_MAX = 2000
+GAP_WAIT_SEC = 0.3      # сколько ждать, пока пропуск заполнится сам (история по TCP, перестановка датаграмм)
+
+ATTACH_CHUNK_SIZE = 256 * 1024
+ATTACH_PREFIX = "attach:"
 
 CONNECT_TIMEOUT_SEC = 10.0     # таймаут установления соединения
 SOCKET_TIMEOUT_SEC  = 600.0    # таймаут операций после подключения (10 минут)
+JOIN_ATTEMPTS       = 10       # сколько раз повторять вход после BUSY
 
 def read_exact(sock: socket.socket, n: int) -> bytes:
     """Читает ровно n байт или бросает EOFError при закрытии соединения/таймауте."""
@@ -45,10 +100,13 @@ def read_exact(sock: socket.socket, n: int) -> bytes:
         buf.extend(chunk)
     return bytes(buf)
 
+_send_lock = threading.Lock()
+
 def send_frame(sock: socket.socket, ftype: int, payload: bytes) -> None:
-    """Отправить кадр по протоколу."""
+    """Отправить кадр по протоколу (потокобезопасно: шлют и stdin-поток, и поток приёма)."""
     hdr = struct.pack(">BI", ftype, len(payload))  # 1 байт тип, 4 байта длина (big-endian)
-    sock.sendall(hdr + payload)
+    with _send_lock:
+        sock.sendall(hdr + payload)
 
 def recv_frame(sock: socket.socket):
     """Принять кадр: возвращает (type, payload: bytes)."""
@@ -78,27 +136,310 @@ def parse_broadcast_payload(payload: bytes):
     message = payload[pos:pos+mlen].decode("utf-8", errors="replace")
     return ts_ms, username, message
 
+def parse_direct_payload(payload: bytes):
+    """Разбор payload MSG_DIRECT: ts_ms(8BE) + from(str16) + to(str16) + mlen(4BE) + message(mlen)."""
+    ts_ms = struct.unpack(">Q", payload[0:8])[0]
+    pos = 8
+    names = []
+    for _ in range(2):
+        n = struct.unpack(">H", payload[pos:pos+2])[0]
+        names.append(payload[pos+2:pos+2+n].decode("utf-8", errors="replace"))
+        pos += 2 + n
+    mlen = struct.unpack(">I", payload[pos:pos+4])[0]
+    message = payload[pos+4:pos+4+mlen].decode("utf-8", errors="replace")
+    return ts_ms, names[0], names[1], message
+
+def str16(s: bytes) -> bytes:
+    return struct.pack(">H", len(s)) + s
+
+def get_str16(payload: bytes, pos: int):
+    n = struct.unpack(">H", payload[pos:pos+2])[0]
+    return payload[pos+2:pos+2+n], pos + 2 + n
+
+# Вложения: id -> (имя, размер) из увиденных ссылок; подтверждения загрузки; открытые скачивания
+_attachments = {}
+_acks = {}
+_ack_ev = threading.Condition()
+_downloads = {}
+
+def parse_attach_ref(text: str):
+    """"attach:<id>:<size>:<name>[\\n подпись]" -> (id, size, name, подпись) или None."""
+    if not text.startswith(ATTACH_PREFIX):
+        return None
+    head, _, caption = text.partition("\n")
+    parts = head[len(ATTACH_PREFIX):].split(":", 2)
+    if len(parts) != 3 or not parts[1].isdigit():
+        return None
+    return parts[0], int(parts[1]), parts[2], caption
+
+def wait_ack(aid: str, timeout: float = 30.0):
+    with _ack_ev:
+        _ack_ev.wait_for(lambda: aid in _acks, timeout)
+        return _acks.pop(aid, None)
+
+def upload(sock: socket.socket, path: str, caption: str) -> None:
+    """Загрузка с продолжением: сервер говорит, сколько байт у него уже есть."""
+    with open(path, "rb") as f:
+        data = f.read()
+    aid = hashlib.sha256(data).hexdigest()
+    bid = aid.encode()
+    size = len(data)
+    send_frame(sock, ATTACH_BEGIN, str16(bid) + struct.pack(">Q", size))
+    have = wait_ack(aid)
+    while have is not None and have < size:
+        for off in range(have, size, ATTACH_CHUNK_SIZE):
+            chunk = data[off:off+ATTACH_CHUNK_SIZE]
+            send_frame(sock, ATTACH_CHUNK, str16(bid) + struct.pack(">QQ", size, off) + chunk)
+        have = wait_ack(aid)
+    if have != size:
+        print("[client] upload failed:", path)
+        return
+    name = os.path.basename(path).encode("utf-8")
+    send_frame(sock, MSG_ATTACH, str16(bid) + str16(name) + caption.encode("utf-8"))
+
+def on_blob_data(payload: bytes) -> None:
+    bid, pos = get_str16(payload, 0)
+    aid = bid.decode()
+    off = struct.unpack(">Q", payload[pos:pos+8])[0]
+    dl = _downloads.get(aid)
+    if dl is None:
+        return
+    f, path, size = dl
+    f.seek(off)
+    f.write(payload[pos+8:])
+    if f.tell() >= size:
+        f.close()
+        del _downloads[aid]
+        print(f"[client] saved {path} ({size} B)")
+
+def broadcast_seq(payload: bytes) -> int:
+    """seq из хвоста MSG_BROADCAST (0, если сервер его не прислал)."""
+    ulen = struct.unpack(">H", payload[8:10])[0]
+    pos = 10 + ulen
+    mlen = struct.unpack(">I", payload[pos:pos+4])[0]
+    pos += 4 + mlen
+    return struct.unpack(">Q", payload[pos:pos+8])[0] if len(payload) >= pos + 8 else 0
+
+class McastState:
+    """Порядок доставки в режиме multicast: показываем по seq, пропуски добираем по TCP."""
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.active = False
+        self.last = 0           # последний показанный seq
+        self.pending = {}       # seq -> payload, пришедшие раньше своей очереди
+        self.tail = 0           # последний seq из MCAST_TAIL
+        self.gap_since = None
+        self.fetching = False
+
+_mcast = McastState()
+
+def show_broadcast(payload: bytes) -> None:
+    try:
+        ts_ms, user, text = parse_broadcast_payload(payload)
+        ref = parse_attach_ref(text)
+        if ref:
+            aid, size, name, caption = ref
+            _attachments[aid] = (name, size)
+            text = f"📎 {name} ({size} B) /get {aid}" + (f" — {caption}" if caption else "")
+        print(f"[{fmt_time_ms(ts_ms)}] {user}: {text}")
+    except Exception as e:
+        print("[client] failed to parse broadcast:", e)
+
+def _flush_pending() -> None:
+    st = _mcast
+    while st.last + 1 in st.pending:
+        st.last += 1
+        show_broadcast(st.pending.pop(st.last))
+    for s in [s for s in st.pending if s <= st.last]:
+        del st.pending[s]
+    if not st.pending and st.tail <= st.last:
+        st.gap_since = None
+
+def _check_gap(sock: socket.socket) -> None:
+    """Запросить пропуск по TCP, если он не закрылся сам за GAP_WAIT_SEC."""
+    st = _mcast
+    end = min(st.pending) - 1 if st.pending else st.tail
+    if end <= st.last or st.fetching:
+        return
+    now = time.time()
+    if st.gap_since is None:
+        st.gap_since = now
+        return
+    if now - st.gap_since < GAP_WAIT_SEC:
+        return
+    if st.last == 0:
+        # Ничего не получено по TCP (история выключена) — начинаем с первой датаграммы.
+        st.last = end
+        _flush_pending()
+        return
+    st.fetching = True
+    st.gap_since = now
+    send_frame(sock, GAP_FETCH, struct.pack(">QH", st.last, min(end - st.last, GAP_MAX)))
+
+def on_broadcast(sock: socket.socket, payload: bytes, via_mcast: bool) -> None:
+    st = _mcast
+    seq = broadcast_seq(payload)
+    if not st.active or seq == 0:
+        show_broadcast(payload)
+        return
+    with st.lock:
+        if seq <= st.last:
+            return
+        if via_mcast:
+            st.pending[seq] = payload
+        else:
+            # По TCP приходят история при входе и ответы на GAP_FETCH — уже по порядку.
+            st.fetching = False
+            st.last = seq
+            show_broadcast(payload)
+        _flush_pending()
+        _check_gap(sock)
+
+def on_gap_miss() -> None:
+    """Сервер уже не хранит пропуск — пропускаем его."""
+    st = _mcast
+    with st.lock:
+        st.fetching = False
+        skip_to = (min(st.pending) - 1) if st.pending else st.tail
+        if skip_to > st.last:
+            print(f"[client] messages {st.last + 1}..{skip_to} are no longer available")
+            st.last = skip_to
+        _flush_pending()
+
+def mcast_loop(sock: socket.socket, group: str, port: int, iface: str, stop_ev: threading.Event) -> None:
+    us = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    us.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    us.bind(("", port))
+    mreq = socket.inet_aton(group) + socket.inet_aton(iface)
+    us.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    us.settimeout(0.5)
+    _mcast.active = True
+    print(f"[client] receiving broadcasts via multicast {group}:{port}")
+    try:
+        while not stop_ev.is_set():
+            try:
+                data = us.recv(65536)
+            except socket.timeout:
+                with _mcast.lock:
+                    _check_gap(sock)
+                continue
+            if len(data) < 5:
+                continue
+            ftype, length = struct.unpack(">BI", data[:5])
+            body = data[5:5+length]
+            if ftype == MSG_BROADCAST:
+                on_broadcast(sock, body, True)
+            elif ftype == MCAST_TAIL and len(body) == 8:
+                with _mcast.lock:
+                    _mcast.tail = max(_mcast.tail, struct.unpack(">Q", body)[0])
+                    _check_gap(sock)
+    except OSError as e:
+        print(f"[client] multicast error: {e}")
+    finally:
+        us.close()
+
 def fmt_time_ms(ts_ms: int) -> str:
     try:
         return datetime.fromtimestamp(ts_ms/1000.0).strftime("%Y-%m-%d %H:%M:%S")
     except Exception:
         return str(ts_ms)
 
-def receiver_loop(sock: socket.socket, stop_ev: threading.Event):
+class ShmReader:
+    """Потребитель кольца сервер -> клиент в общей памяти (см. ShmRingHeader в shm_ring.hpp)."""
+    HEADER = 4096
+    OFF_HEAD, OFF_TAIL, OFF_WAITING = 64, 128, 192
+
+    def __init__(self, sock: socket.socket, memfd: int, efd: int, capacity: int):
+        self.sock = sock
+        self.efd = efd
+        self.cap = capacity
+        self.mm = mmap.mmap(memfd, self.HEADER + capacity)
+        os.close(memfd)
+        magic, version = struct.unpack_from("<II", self.mm, 0)
+        if magic != 0x4C435352 or version != 1:
+            raise ValueError("unexpected shm ring layout")
+
+    def _u64(self, off: int) -> int:
+        return struct.unpack_from("<Q", self.mm, off)[0]
+
+    def _read(self, pos: int, n: int) -> bytes:
+        at = self.HEADER + pos % self.cap
+        first = min(n, self.HEADER + self.cap - at)
+        data = self.mm[at:at+first]
+        if first < n:
+            data += self.mm[self.HEADER:self.HEADER + n - first]
+        return data
+
+    def recv_frame(self):
+        while True:
+            tail = self._u64(self.OFF_TAIL)
+            if self._u64(self.OFF_HEAD) != tail:
+                break
+            struct.pack_into("<I", self.mm, self.OFF_WAITING, 1)
+            if self._u64(self.OFF_HEAD) == tail:
+                r, _, _ = select.select([self.efd, self.sock], [], [], 1.0)
+                if self.efd in r:
+                    os.read(self.efd, 8)
+                if self.sock in r and not self.sock.recv(1, socket.MSG_PEEK):
+                    raise EOFError("connection closed by peer")
+            struct.pack_into("<I", self.mm, self.OFF_WAITING, 0)
+        ftype, length = struct.unpack(">BI", self._read(tail, 5))
+        payload = self._read(tail + 5, length) if length else b""
+        struct.pack_into("<Q", self.mm, self.OFF_TAIL, tail + 5 + length)
+        return ftype, payload
+
+def open_shm(sock: socket.socket):
+    """Принять SHM_INFO с memfd и eventfd; None, если сервер кольцо не выдал."""
+    msg, fds, _, _ = socket.recv_fds(sock, 5 + 8, 2)
+    if len(fds) != 2 or len(msg) != 13 or msg[0] != SHM_INFO:
+        for fd in fds:
+            os.close(fd)
+        return None
+    return ShmReader(sock, fds[0], fds[1], struct.unpack(">Q", msg[5:])[0])
+
+def busy_retry_ms(sock: socket.socket):
+    """Если первый кадр сервера — BUSY, прочитать его и вернуть retry_after_ms; иначе None (кадр остаётся в сокете)."""
+    head = sock.recv(1, socket.MSG_PEEK)
+    if not head or head[0] != BUSY:
+        return None
+    _, payload = recv_frame(sock)
+    return struct.unpack(">I", payload[:4])[0] if len(payload) >= 4 else 1000
+
+def receiver_loop(sock: socket.socket, stop_ev: threading.Event, mcast_if: str = "0.0.0.0", shm=None):
     """Поток приёма: печатает всё входящее (история + live)."""
     try:
         while not stop_ev.is_set():
-            ftype, payload = recv_frame(sock)
+            ftype, payload = shm.recv_frame() if shm else recv_frame(sock)
             if ftype == OK:
                 print("[server] OK")
             elif ftype == ERR:
-                print("[server] ERR:", payload.decode("utf-8", errors="replace"))
+                err = payload.decode("utf-8", errors="replace")
+                if err == "Gap not available":
+                    on_gap_miss()
+                else:
+                    print("[server] ERR:", err)
             elif ftype == MSG_BROADCAST:
+                on_broadcast(sock, payload, False)
+            elif ftype == MCAST_INFO:
+                group, pos = get_str16(payload, 0)
+                port = struct.unpack(">H", payload[pos:pos+2])[0]
+                threading.Thread(target=mcast_loop, args=(sock, group.decode(), port, mcast_if, stop_ev),
+                                 daemon=True).start()
+            elif ftype == MSG_DIRECT:
                 try:
-                    ts_ms, user, text = parse_broadcast_payload(payload)
-                    print(f"[{fmt_time_ms(ts_ms)}] {user}: {text}")
+                    ts_ms, frm, to, text = parse_direct_payload(payload)
+                    print(f"[{fmt_time_ms(ts_ms)}] {frm} -> {to}: {text}")
                 except Exception as e:
-                    print("[client] failed to parse broadcast:", e)
+                    print("[client] failed to parse direct message:", e)
+            elif ftype == ATTACH_ACK:
+                bid, pos = get_str16(payload, 0)
+                with _ack_ev:
+                    _acks[bid.decode()] = struct.unpack(">Q", payload[pos:pos+8])[0]
+                    _ack_ev.notify_all()
+            elif ftype == BLOB_DATA:
+                on_blob_data(payload)
+            elif ftype == PING:
+                send_frame(sock, PONG, b"")
             else:
                 # неизвестные кадры игнорим
                 pass
@@ -123,6 +464,29 @@ def stdin_loop(sock: socket.socket, stop_ev: threading.Event):
             if line == "/quit":
                 stop_ev.set()
                 break
+            if line.startswith("/dm "):
+                parts = line.split(" ", 2)
+                if len(parts) < 3:
+                    print("[client] usage: /dm <user> <text>")
+                    continue
+                to = parts[1].encode("utf-8")
+                send_frame(sock, DM, struct.pack(">H", len(to)) + to + parts[2].encode("utf-8"))
+                continue
+            if line.startswith("/send "):
+                parts = line.split(" ", 2)
+                caption = parts[2] if len(parts) > 2 else ""
+                threading.Thread(target=upload, args=(sock, parts[1], caption), daemon=True).start()
+                continue
+            if line.startswith("/get "):
+                aid = line[5:].strip()
+                name, size = _attachments.get(aid, (aid[:12], None))
+                if size is None:
+                    print("[client] unknown attachment:", aid)
+                    continue
+                path = name if not os.path.exists(name) else f"{aid[:8]}-{name}"
+                _downloads[aid] = (open(path, "wb"), path, size)
+                send_frame(sock, BLOB_GET, str16(aid.encode()) + struct.pack(">Q", 0))
+                continue
             payload = line.encode("utf-8")
             send_frame(sock, MSG, payload)
     except (BrokenPipeError, OSError, EOFError, socket.timeout):
@@ -135,30 +499,69 @@ def main():
     ap.add_argument("--host", default="127.0.0.1", help="Server host (default: 127.0.0.1)")
     ap.add_argument("--port", type=int, default=5555, help="Server port (default: 5555)")
     ap.add_argument("--user", required=True, help="Username")
+    ap.add_argument("--mcast", action="store_true", help="Receive broadcasts via server's UDP multicast group")
+    ap.add_argument("--mcast-if", default="0.0.0.0", help="Local IPv4 interface for multicast (default: any)")
+    ap.add_argument("--unix", help="Connect via server's unix socket instead of TCP")
+    ap.add_argument("--shm", action="store_true", help="With --unix: receive frames via shared-memory ring")
     args = ap.parse_args()
 
-    # Создаём TCP-соединение
-    try:
-        sock = socket.create_connection((args.host, args.port), timeout=CONNECT_TIMEOUT_SEC)
-        # Увеличим таймаут операций (recv/send) до 10 минут
-        sock.settimeout(SOCKET_TIMEOUT_SEC)
-    except OSError as e:
-        print(f"[client] cannot connect to {args.host}:{args.port} -> {e}")
-        return 2
+    shm = None
+    for attempt in range(JOIN_ATTEMPTS):
+        # Создаём TCP-соединение (или Unix-сокет для локальных ботов)
+        try:
+            if args.unix:
+                sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                sock.settimeout(CONNECT_TIMEOUT_SEC)
+                sock.connect(args.unix)
+            else:
+                sock = socket.create_connection((args.host, args.port), timeout=CONNECT_TIMEOUT_SEC)
+            # Увеличим таймаут операций (recv/send) до 10 минут
+            sock.settimeout(SOCKET_TIMEOUT_SEC)
+        except OSError as e:
+            print(f"[client] cannot connect to {args.unix or f'{args.host}:{args.port}'} -> {e}")
+            return 2
+
+        # Отправляем HELLO
+        try:
+            uname = args.user.encode("utf-8")
+            exts = b""
+            if args.mcast:
+                exts += bytes([HELLO_EXT_MCAST]) + struct.pack(">H", 0)
+            if args.unix and args.shm:
+                exts += bytes([HELLO_EXT_SHM]) + struct.pack(">H", 0)
+            send_frame(sock, HELLO, uname + (b"\x00" + exts if exts else b""))
+            retry_ms = busy_retry_ms(sock)
+        except (OSError, EOFError) as e:
+            print(f"[client] send HELLO failed: {e}")
+            sock.close()
+            return 3
+        if retry_ms is None:
+            break
+        sock.close()
+        # Случайная добавка, чтобы отказанные клиенты не вернулись все в одну и ту же секунду.
+        delay = retry_ms / 1000.0 * (1.0 + random.random() / 2)
+        print(f"[server] busy, retrying in {delay:.1f}s")
+        time.sleep(delay)
+    else:
+        print("[client] server is still busy, giving up")
+        return 4
 
-    # Отправляем HELLO
     try:
-        uname = args.user.encode("utf-8")
-        send_frame(sock, HELLO, uname)
-    except OSError as e:
-        print(f"[client] send HELLO failed: {e}")
+        if args.unix and args.shm:
+            shm = open_shm(sock)
+            if shm is None:
+                print("[client] server did not offer a shm ring; reconnect without --shm")
+                sock.close()
+                return 3
+    except (OSError, ValueError) as e:
+        print(f"[client] shm ring setup failed: {e}")
         sock.close()
         return 3
 
     stop_ev = threading.Event()
 
     # Поток приёма
-    t_recv = threading.Thread(target=receiver_loop, args=(sock, stop_ev), daemon=True)
+    t_recv = threading.Thread(target=receiver_loop, args=(sock, stop_ev, args.mcast_if, shm), daemon=True)
     t_recv.start()
 
     # Поток ввода
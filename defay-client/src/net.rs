@@ -1,3 +1,5 @@
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
 use tokio::io::{AsyncReadExt, AsyncWriteExt};
 use tokio::net::TcpStream;
 use tokio::sync::mpsc;
@@ -6,7 +8,14 @@ pub const T_HELLO: u8 = 0x01;
 pub const T_MSG: u8 = 0x02;
 pub const T_ERR: u8 = 0x05;
 pub const T_OK: u8 = 0x06;
+pub const T_PING: u8 = 0x07;
+pub const T_PONG: u8 = 0x08;
 pub const T_MSG_BROADCAST: u8 = 0x12;
+pub const T_BUSY: u8 = 0x17;
+
+const HELLO_EXT_RESUME: u8 = 0x01;
+// Сколько раз повторять вход, если сервер ответил BUSY.
+const JOIN_ATTEMPTS: u32 = 10;
 
 #[derive(Debug, Clone)]
 pub enum NetCmd {
@@ -16,6 +25,7 @@ pub enum NetCmd {
         nick: String,
     },
     SendText(String),
+    Pong,
     Disconnect,
     Stop,
 }
@@ -51,6 +61,7 @@ impl Drop for NetHandle {
 pub fn start_net_runtime() -> NetHandle {
     let (tx_cmd, mut rx_cmd) = mpsc::channel::<NetCmd>(64);
     let (tx_evt, rx_evt) = mpsc::channel::<NetEvent>(256);
+    let tx_cmd_loop = tx_cmd.clone();
 
     std::thread::spawn(move || {
         let rt = tokio::runtime::Builder::new_multi_thread()
@@ -63,6 +74,10 @@ pub fn start_net_runtime() -> NetHandle {
 
             let mut writer: Option<tokio::io::WriteHalf<TcpStream>> = None;
             let mut reader_task: Option<tokio::task::JoinHandle<()>> = None;
+            // Последний полученный seq: при переподключении к тому же серверу
+            // отправляется в HELLO (RESUME), и сервер досылает только пропущенное.
+            let last_seq = Arc::new(AtomicU64::new(0));
+            let mut last_addr = String::new();
 
             let close_conn =
                 |reason: &str,
@@ -75,8 +90,15 @@ pub fn start_net_runtime() -> NetHandle {
                     if writer.take().is_some() {}
                 };
 
+            // Команда, пришедшая во время ожидания после BUSY: обрабатывается следующей.
+            let mut pending: Option<NetCmd> = None;
+
             loop {
-                match rx_cmd.recv().await {
+                let cmd = match pending.take() {
+                    Some(cmd) => Some(cmd),
+                    None => rx_cmd.recv().await,
+                };
+                match cmd {
                     None | Some(NetCmd::Stop) => {
                         close_conn("stop", &mut reader_task, &mut writer);
                         let _ = tx_evt
@@ -98,72 +120,139 @@ pub fn start_net_runtime() -> NetHandle {
                         close_conn("reconnect", &mut reader_task, &mut writer);
                         let addr = format!("{host}:{port}");
                         log::info!("net: connecting to {addr} as '{nick}'");
+                        if addr != last_addr {
+                            last_seq.store(0, Ordering::Relaxed);
+                            last_addr = addr.clone();
+                        }
 
-                        match TcpStream::connect(&addr).await {
-                            Err(e) => {
+                        for attempt in 1..=JOIN_ATTEMPTS {
+                            let stream = match TcpStream::connect(&addr).await {
+                                Ok(stream) => stream,
+                                Err(e) => {
+                                    let _ = tx_evt
+                                        .send(NetEvent::Error {
+                                            msg: format!("connect({addr}) failed: {e}"),
+                                        })
+                                        .await;
+                                    break;
+                                }
+                            };
+                            let (mut rd, mut wr) = tokio::io::split(stream);
+
+                            let mut hello = nick.as_bytes().to_vec();
+                            let resume = last_seq.load(Ordering::Relaxed);
+                            if resume > 0 {
+                                hello.push(0);
+                                hello.push(HELLO_EXT_RESUME);
+                                hello.extend_from_slice(&8u16.to_be_bytes());
+                                hello.extend_from_slice(&resume.to_be_bytes());
+                            }
+                            if let Err(e) = send_frame(&mut wr, T_HELLO, &hello).await {
                                 let _ = tx_evt
                                     .send(NetEvent::Error {
-                                        msg: format!("connect({addr}) failed: {e}"),
+                                        msg: format!("send HELLO failed: {e}"),
                                     })
                                     .await;
+                                break;
                             }
-                            Ok(stream) => {
-                                let (mut rd, mut wr) = tokio::io::split(stream);
+                            log::info!("net: HELLO sent, waiting for OK/ERR…");
 
-                                if let Err(e) = send_frame(&mut wr, T_HELLO, nick.as_bytes()).await
-                                {
-                                    let _ = tx_evt
-                                        .send(NetEvent::Error {
-                                            msg: format!("send HELLO failed: {e}"),
-                                        })
-                                        .await;
-                                    continue;
+                            match read_frame(&mut rd).await {
+                                Ok((T_OK, _)) => {
+                                    log::info!("net: handshake OK, starting reader loop");
+                                    let tx_evt_clone = tx_evt.clone();
+                                    let tx_cmd_clone = tx_cmd_loop.clone();
+                                    let seq_clone = last_seq.clone();
+                                    reader_task = Some(tokio::spawn(async move {
+                                        if let Err(e) =
+                                            reader_loop(rd, tx_evt_clone, tx_cmd_clone, seq_clone)
+                                                .await
+                                        {
+                                            log::error!("net: reader_loop error: {e}");
+                                        }
+                                    }));
+                                    writer = Some(wr);
+                                    let _ = tx_evt.send(NetEvent::Connected).await;
                                 }
-                                log::info!("net: HELLO sent, waiting for OK/ERR…");
-
-                                match read_frame(&mut rd).await {
-                                    Ok((T_OK, _)) => {
-                                        log::info!("net: handshake OK, starting reader loop");
-                                        let tx_evt_clone = tx_evt.clone();
-                                        reader_task = Some(tokio::spawn(async move {
-                                            if let Err(e) = reader_loop(rd, tx_evt_clone).await {
-                                                log::error!("net: reader_loop error: {e}");
-                                            }
-                                        }));
-                                        writer = Some(wr);
-                                        let _ = tx_evt.send(NetEvent::Connected).await;
-                                    }
-                                    Ok((T_ERR, payload)) => {
-                                        let msg = String::from_utf8_lossy(&payload).to_string();
+                                Ok((T_BUSY, payload)) => {
+                                    let (retry_ms, reason) = parse_busy(&payload);
+                                    if attempt == JOIN_ATTEMPTS {
                                         let _ = tx_evt
                                             .send(NetEvent::Error {
-                                                msg: format!("handshake ERR: {msg}"),
+                                                msg: format!("server is still busy: {reason}"),
                                             })
                                             .await;
                                         let _ = tx_evt
                                             .send(NetEvent::Disconnected {
-                                                reason: "handshake_err".into(),
-                                            })
-                                            .await;
-                                    }
-                                    Ok((other, _)) => {
-                                        let _ = tx_evt
-                                            .send(NetEvent::Error {
-                                                msg: format!(
-                                                    "unexpected handshake frame: 0x{other:02x}"
-                                                ),
+                                                reason: "busy".into(),
                                             })
                                             .await;
+                                        break;
                                     }
-                                    Err(e) => {
-                                        let _ = tx_evt
-                                            .send(NetEvent::Error {
-                                                msg: format!("handshake read failed: {e}"),
-                                            })
-                                            .await;
+                                    // Случайная добавка, чтобы отказанные клиенты не вернулись
+                                    // все в одну и ту же секунду.
+                                    let delay = std::time::Duration::from_secs_f64(
+                                        retry_ms as f64 / 1000.0
+                                            * (1.0 + rand::random::<f64>() / 2.0),
+                                    );
+                                    log::info!("net: server busy ({reason}), retry in {delay:?}");
+                                    let _ = tx_evt
+                                        .send(NetEvent::Error {
+                                            msg: format!(
+                                                "server busy, retrying in {:.1}s ({attempt}/{JOIN_ATTEMPTS})",
+                                                delay.as_secs_f64()
+                                            ),
+                                        })
+                                        .await;
+                                    drop((rd, wr));
+                                    // Любая команда пользователя прерывает ожидание.
+                                    pending = tokio::select! {
+                                        _ = tokio::time::sleep(delay) => None,
+                                        cmd = rx_cmd.recv() => Some(cmd.unwrap_or(NetCmd::Stop)),
+                                    };
+                                    if pending.is_some() {
+                                        break;
                                     }
+                                    continue;
+                                }
+                                Ok((T_ERR, payload)) => {
+                                    let msg = String::from_utf8_lossy(&payload).to_string();
+                                    let _ = tx_evt
+                                        .send(NetEvent::Error {
+                                            msg: format!("handshake ERR: {msg}"),
+                                        })
+                                        .await;
+                                    let _ = tx_evt
+                                        .send(NetEvent::Disconnected {
+                                            reason: "handshake_err".into(),
+                                        })
+                                        .await;
+                                }
+                                Ok((other, _)) => {
+                                    let _ = tx_evt
+                                        .send(NetEvent::Error {
+                                            msg: format!(
+                                                "unexpected handshake frame: 0x{other:02x}"
+                                            ),
+                                        })
+                                        .await;
+                                }
+                                Err(e) => {
+                                    let _ = tx_evt
+                                        .send(NetEvent::Error {
+                                            msg: format!("handshake read failed: {e}"),
+                                        })
+                                        .await;
                                 }
                             }
+                            break;
+                        }
+                    }
+                    Some(NetCmd::Pong) => {
+                        if let Some(wr) = writer.as_mut() {
+                            if let Err(e) = send_frame(wr, T_PONG, &[]).await {
+                                log::warn!("net: send PONG failed: {e}");
+                            }
                         }
                     }
                     Some(NetCmd::SendText(text)) => {
@@ -221,9 +310,21 @@ async fn read_frame<R: AsyncReadExt + Unpin>(r: &mut R) -> anyhow::Result<(u8, V
     Ok((typ, payload))
 }
 
+// BUSY: retry_after_ms (u32 BE), затем причина (utf-8).
+fn parse_busy(payload: &[u8]) -> (u64, String) {
+    if payload.len() < 4 {
+        return (1000, String::new());
+    }
+    let retry_ms = u32::from_be_bytes(payload[0..4].try_into().unwrap()) as u64;
+    let reason = String::from_utf8_lossy(&payload[4..]).to_string();
+    (retry_ms, reason)
+}
+
 async fn reader_loop<R: AsyncReadExt + Unpin>(
     mut rd: R,
     tx_evt: mpsc::Sender<NetEvent>,
+    tx_cmd: mpsc::Sender<NetCmd>,
+    last_seq: Arc<AtomicU64>,
 ) -> anyhow::Result<()> {
     loop {
         let (typ, payload) = read_frame(&mut rd).await?;
@@ -266,6 +367,14 @@ async fn reader_loop<R: AsyncReadExt + Unpin>(
                     continue;
                 }
                 let text = String::from_utf8_lossy(&p[..mlen]).to_string();
+                p = &p[mlen..];
+                if p.len() >= 8 {
+                    let seq = u64::from_be_bytes(p[0..8].try_into().unwrap());
+                    if seq <= last_seq.load(Ordering::Relaxed) {
+                        continue;
+                    }
+                    last_seq.store(seq, Ordering::Relaxed);
+                }
                 log::info!("net: recv msg from {username} ({mlen} bytes)");
 
                 let _ = tx_evt
@@ -277,6 +386,9 @@ async fn reader_loop<R: AsyncReadExt + Unpin>(
                     .await;
             }
             T_OK => {}
+            T_PING => {
+                let _ = tx_cmd.send(NetCmd::Pong).await;
+            }
             T_ERR => {
                 let msg = String::from_utf8_lossy(&payload).to_string();
                 let _ = tx_evt.send(NetEvent::Error { msg }).await;
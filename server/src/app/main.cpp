@@ -1,6 +1,8 @@
 #include "config/config.hpp"
 #include "net/server.hpp"
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <thread>
 #include <atomic>
@@ -32,7 +34,18 @@ int main(int argc, char** argv){
   if (!srv.start()) return 1;
 
   std::cout << "Press Ctrl+C to stop (or close window on Windows).\n";
+  const auto promote_flag = std::filesystem::path(cfg.data_dir) / "promote";
   while(!g_exit.load()){
+    if (!cfg.replicate_from.empty() && std::filesystem::exists(promote_flag)){
+      std::string mode;
+      std::ifstream(promote_flag.string()) >> mode;
+      std::error_code ec;
+      std::filesystem::remove(promote_flag, ec);
+      if (srv.promote(mode == "force")){
+        cfg.replicate_from.clear();
+        lanchat::save_config_file(lanchat::default_ini_path(), cfg);
+      }
+    }
 #ifdef _WIN32
     Sleep(200);
 #else
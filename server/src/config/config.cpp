@@ -18,7 +18,7 @@
 
 namespace lanchat {
 
-static std::string default_ini_path(){
+std::string default_ini_path(){
   return std::string("data") + "/" + "server.ini";
 }
 
@@ -48,10 +48,33 @@ void print_usage(const char* argv0){
     " [--data ./data]"
     " [--secret KEY]"
     " [--hist 20]"
-    " [--enc-key-hex <64hex>]\n";
+    " [--shards 1]"
+    " [--backlog 128]"
+    " [--ping-sec 30]"
+    " [--idle-timeout 90]"
+    " [--enc-key-hex <64hex>]"
+    " [--node-id ID]"
+    " [--peer host:port]..."
+    " [--follow leader_host:port]"
+    " [--snapshot-sec 60]"
+    " [--retention-days N]"
+    " [--retention-mb N]"
+    " [--ring N]"
+    " [--warm-cache-mb N]"
+    " [--trace-rate 0.01]"
+    " [--mem-limit-mb 512]"
+    " [--conn-mem-kb 2048]"
+    " [--capture-mb N] [--capture-plaintext]"
+    " [--cpu-threads N]"
+    " [--attach-max-mb 64] [--attach-quota-mb 4096] [--attach-partial-hours 24] [--attach-plaintext]"
+    " [--mcast group:port] [--mcast-if IP] [--mcast-ttl 1] [--mcast-mtu 1500]"
+    " [--unix-socket PATH] [--shm-ring-kb 4096]"
+    " [--batch-us 1000] [--batch-kb 64]"
+    " [--join-rate 0] [--join-burst 100] [--join-queue 512] [--join-wait-ms 5000]\n";
 }
 
 void parse_args(int argc, char** argv, Config& cfg){
+  bool peers_from_cli = false;
   for (int i = 1; i < argc; ++i){
     std::string a = argv[i];
     auto next = [&](const char* err)->std::string{
@@ -64,11 +87,48 @@ void parse_args(int argc, char** argv, Config& cfg){
     else if (a == "--data")   cfg.data_dir = next("missing --data value");
     else if (a == "--secret") cfg.secret   = next("missing --secret value");
     else if (a == "--hist")   cfg.history_on_join = static_cast<std::size_t>(std::stoul(next("missing --hist value")));
+    else if (a == "--shards") cfg.accept_shards = static_cast<std::size_t>(std::stoul(next("missing --shards value")));
+    else if (a == "--backlog") cfg.listen_backlog = static_cast<std::size_t>(std::stoul(next("missing --backlog value")));
+    else if (a == "--ping-sec") cfg.ping_sec = static_cast<std::size_t>(std::stoul(next("missing --ping-sec value")));
+    else if (a == "--idle-timeout") cfg.idle_timeout_sec = static_cast<std::size_t>(std::stoul(next("missing --idle-timeout value")));
     else if (a == "--enc-key-hex"){
       cfg.enc_key_hex = next("missing --enc-key-hex value");
       if (cfg.enc_key_hex.size() == 64) cfg.enc_enabled = true;
       else { std::cerr << "--enc-key-hex must be 64 hex chars (32 bytes)\n"; std::exit(1); }
     }
+    else if (a == "--node-id") cfg.node_id = next("missing --node-id value");
+    else if (a == "--peer"){
+      if (!peers_from_cli){ cfg.peers.clear(); peers_from_cli = true; }
+      cfg.peers.push_back(next("missing --peer value"));
+    }
+    else if (a == "--follow")  cfg.replicate_from = next("missing --follow value");
+    else if (a == "--mcast")   cfg.mcast = next("missing --mcast value");
+    else if (a == "--mcast-if") cfg.mcast_if = next("missing --mcast-if value");
+    else if (a == "--unix-socket") cfg.unix_socket = next("missing --unix-socket value");
+    else if (a == "--shm-ring-kb") cfg.shm_ring_kb = static_cast<std::size_t>(std::stoul(next("missing --shm-ring-kb value")));
+    else if (a == "--batch-us") cfg.batch_us = static_cast<std::size_t>(std::stoul(next("missing --batch-us value")));
+    else if (a == "--batch-kb") cfg.batch_kb = static_cast<std::size_t>(std::stoul(next("missing --batch-kb value")));
+    else if (a == "--join-rate") cfg.join_rate = static_cast<std::size_t>(std::stoul(next("missing --join-rate value")));
+    else if (a == "--join-burst") cfg.join_burst = static_cast<std::size_t>(std::stoul(next("missing --join-burst value")));
+    else if (a == "--join-queue") cfg.join_queue = static_cast<std::size_t>(std::stoul(next("missing --join-queue value")));
+    else if (a == "--join-wait-ms") cfg.join_wait_ms = static_cast<std::size_t>(std::stoul(next("missing --join-wait-ms value")));
+    else if (a == "--mcast-ttl") cfg.mcast_ttl = static_cast<std::size_t>(std::stoul(next("missing --mcast-ttl value")));
+    else if (a == "--mcast-mtu") cfg.mcast_mtu = static_cast<std::size_t>(std::stoul(next("missing --mcast-mtu value")));
+    else if (a == "--snapshot-sec") cfg.snapshot_sec = static_cast<std::size_t>(std::stoul(next("missing --snapshot-sec value")));
+    else if (a == "--retention-days") cfg.retention_days = static_cast<std::size_t>(std::stoul(next("missing --retention-days value")));
+    else if (a == "--retention-mb") cfg.retention_mb = static_cast<std::size_t>(std::stoul(next("missing --retention-mb value")));
+    else if (a == "--ring") cfg.ring_size = static_cast<std::size_t>(std::stoul(next("missing --ring value")));
+    else if (a == "--warm-cache-mb") cfg.warm_cache_mb = static_cast<std::size_t>(std::stoul(next("missing --warm-cache-mb value")));
+    else if (a == "--mem-limit-mb") cfg.mem_limit_mb = static_cast<std::size_t>(std::stoul(next("missing --mem-limit-mb value")));
+    else if (a == "--conn-mem-kb") cfg.conn_mem_kb = static_cast<std::size_t>(std::stoul(next("missing --conn-mem-kb value")));
+    else if (a == "--cpu-threads") cfg.cpu_threads = static_cast<std::size_t>(std::stoul(next("missing --cpu-threads value")));
+    else if (a == "--attach-max-mb") cfg.attach_max_mb = static_cast<std::size_t>(std::stoul(next("missing --attach-max-mb value")));
+    else if (a == "--attach-quota-mb") cfg.attach_quota_mb = static_cast<std::size_t>(std::stoul(next("missing --attach-quota-mb value")));
+    else if (a == "--attach-partial-hours") cfg.attach_partial_hours = static_cast<std::size_t>(std::stoul(next("missing --attach-partial-hours value")));
+    else if (a == "--attach-plaintext") cfg.attach_plaintext = true;
+    else if (a == "--capture-mb") cfg.capture_mb = static_cast<std::size_t>(std::stoul(next("missing --capture-mb value")));
+    else if (a == "--capture-plaintext") cfg.capture_plaintext = true;
+    else if (a == "--trace-rate") cfg.trace_rate = std::stod(next("missing --trace-rate value"));
     else if (a == "-h" || a == "--help") {
       print_usage(argv[0]); std::exit(0);
     }
@@ -86,6 +146,26 @@ static void trim(std::string& s){
   s = s.substr(a, b-a+1);
 }
 
+static std::vector<std::string> split_list(const std::string& s){
+  std::vector<std::string> out;
+  std::string cur;
+  std::istringstream in(s);
+  while (std::getline(in, cur, ',')){
+    trim(cur);
+    if (!cur.empty()) out.push_back(cur);
+  }
+  return out;
+}
+
+static std::string join_list(const std::vector<std::string>& v){
+  std::string out;
+  for (size_t i=0;i<v.size();++i){
+    if (i) out += ",";
+    out += v[i];
+  }
+  return out;
+}
+
 bool load_config_file(const std::string& path, Config& cfg){
   std::ifstream in(path);
   if (!in.is_open()) return false;
@@ -107,10 +187,48 @@ bool load_config_file(const std::string& path, Config& cfg){
     else if (key=="data") cfg.data_dir = val;
     else if (key=="secret") cfg.secret = val;
     else if (key=="hist"){ try{ cfg.history_on_join = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="shards"){ try{ cfg.accept_shards = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="backlog"){ try{ cfg.listen_backlog = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="ping_sec"){ try{ cfg.ping_sec = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="idle_timeout_sec"){ try{ cfg.idle_timeout_sec = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="hello_timeout_sec"){ try{ cfg.hello_timeout_sec = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
     else if (key=="enc_key_hex"){
       cfg.enc_key_hex = val;
       cfg.enc_enabled = (val.size()==64);
     }
+    else if (key=="node_id") cfg.node_id = val;
+    else if (key=="peers") cfg.peers = split_list(val);
+    else if (key=="follow") cfg.replicate_from = val;
+    else if (key=="mcast") cfg.mcast = val;
+    else if (key=="mcast_if") cfg.mcast_if = val;
+    else if (key=="unix_socket") cfg.unix_socket = val;
+    else if (key=="shm_ring_kb"){ try{ cfg.shm_ring_kb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="batch_us"){ try{ cfg.batch_us = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="batch_kb"){ try{ cfg.batch_kb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="join_rate"){ try{ cfg.join_rate = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="join_burst"){ try{ cfg.join_burst = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="join_queue"){ try{ cfg.join_queue = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="join_wait_ms"){ try{ cfg.join_wait_ms = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="mcast_ttl"){ try{ cfg.mcast_ttl = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="mcast_mtu"){ try{ cfg.mcast_mtu = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="retention_days"){ try{ cfg.retention_days = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="retention_mb"){ try{ cfg.retention_mb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="compact_check_sec"){ try{ cfg.compact_check_sec = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="compact_io_kbps"){ try{ cfg.compact_io_kbps = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="ring"){ try{ cfg.ring_size = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="warm_cache_mb"){ try{ cfg.warm_cache_mb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="mem_limit_mb"){ try{ cfg.mem_limit_mb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="conn_mem_kb"){ try{ cfg.conn_mem_kb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="mem_wait_ms"){ try{ cfg.mem_wait_ms = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="cpu_threads"){ try{ cfg.cpu_threads = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="attach_max_mb"){ try{ cfg.attach_max_mb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="attach_quota_mb"){ try{ cfg.attach_quota_mb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="attach_partial_hours"){ try{ cfg.attach_partial_hours = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="attach_plaintext") cfg.attach_plaintext = (val=="1");
+    else if (key=="capture_mb"){ try{ cfg.capture_mb = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
+    else if (key=="capture_plaintext") cfg.capture_plaintext = (val=="1");
+    else if (key=="trace_rate"){ try{ cfg.trace_rate = std::stod(val); } catch(...){} }
+    else if (key=="snapshot_sec"){ try{ cfg.snapshot_sec = static_cast<std::size_t>(std::stoul(val)); } catch(...){} }
   }
   return true;
 }
@@ -126,10 +244,48 @@ bool save_config_file(const std::string& path, const Config& cfg){
   out << "data=" << cfg.data_dir << "\n";
   out << "secret=" << cfg.secret << "\n";
   out << "hist=" << cfg.history_on_join << "\n";
+  out << "shards=" << cfg.accept_shards << "\n";
+  out << "backlog=" << cfg.listen_backlog << "\n";
+  out << "ping_sec=" << cfg.ping_sec << "\n";
+  out << "idle_timeout_sec=" << cfg.idle_timeout_sec << "\n";
+  out << "hello_timeout_sec=" << cfg.hello_timeout_sec << "\n";
   if (cfg.enc_enabled && cfg.enc_key_hex.size()==64)
     out << "enc_key_hex=" << cfg.enc_key_hex << "\n";
   else
     out << "enc_key_hex=\n";
+  out << "node_id=" << cfg.node_id << "\n";
+  out << "peers=" << join_list(cfg.peers) << "\n";
+  out << "follow=" << cfg.replicate_from << "\n";
+  out << "mcast=" << cfg.mcast << "\n";
+  out << "mcast_if=" << cfg.mcast_if << "\n";
+  out << "mcast_ttl=" << cfg.mcast_ttl << "\n";
+  out << "mcast_mtu=" << cfg.mcast_mtu << "\n";
+  out << "unix_socket=" << cfg.unix_socket << "\n";
+  out << "shm_ring_kb=" << cfg.shm_ring_kb << "\n";
+  out << "batch_us=" << cfg.batch_us << "\n";
+  out << "batch_kb=" << cfg.batch_kb << "\n";
+  out << "join_rate=" << cfg.join_rate << "\n";
+  out << "join_burst=" << cfg.join_burst << "\n";
+  out << "join_queue=" << cfg.join_queue << "\n";
+  out << "join_wait_ms=" << cfg.join_wait_ms << "\n";
+  out << "snapshot_sec=" << cfg.snapshot_sec << "\n";
+  out << "retention_days=" << cfg.retention_days << "\n";
+  out << "retention_mb=" << cfg.retention_mb << "\n";
+  out << "compact_check_sec=" << cfg.compact_check_sec << "\n";
+  out << "compact_io_kbps=" << cfg.compact_io_kbps << "\n";
+  out << "ring=" << cfg.ring_size << "\n";
+  out << "warm_cache_mb=" << cfg.warm_cache_mb << "\n";
+  out << "mem_limit_mb=" << cfg.mem_limit_mb << "\n";
+  out << "conn_mem_kb=" << cfg.conn_mem_kb << "\n";
+  out << "mem_wait_ms=" << cfg.mem_wait_ms << "\n";
+  out << "trace_rate=" << cfg.trace_rate << "\n";
+  out << "capture_mb=" << cfg.capture_mb << "\n";
+  out << "capture_plaintext=" << (cfg.capture_plaintext ? 1 : 0) << "\n";
+  out << "cpu_threads=" << cfg.cpu_threads << "\n";
+  out << "attach_max_mb=" << cfg.attach_max_mb << "\n";
+  out << "attach_quota_mb=" << cfg.attach_quota_mb << "\n";
+  out << "attach_partial_hours=" << cfg.attach_partial_hours << "\n";
+  out << "attach_plaintext=" << (cfg.attach_plaintext ? 1 : 0) << "\n";
   out.flush();
   return true;
 }
@@ -158,6 +314,11 @@ void bootstrap_auto_config(int argc, char** argv, Config& cfg){
     cfg.enc_enabled = true;
   }
 
+  if (cfg.node_id.empty()){
+    auto id = secure_random_bytes(4);
+    cfg.node_id = hex_encode(id);
+  }
+
   save_config_file(ini, cfg);
 
   std::cout << "Config: bind=" << cfg.bind_addr
@@ -165,6 +326,9 @@ void bootstrap_auto_config(int argc, char** argv, Config& cfg){
             << " data=" << cfg.data_dir
             << " hist=" << cfg.history_on_join
             << " enc=" << (cfg.enc_enabled ? "on" : "off")
+            << " node=" << cfg.node_id
+            << " peers=" << cfg.peers.size()
+            << (cfg.replicate_from.empty() ? "" : " follow=" + cfg.replicate_from)
             << "\n";
 }
 
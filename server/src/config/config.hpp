@@ -4,6 +4,7 @@
 #include <string>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace lanchat {
 
@@ -13,11 +14,62 @@ struct Config {
   std::string data_dir = "data";
   std::string secret = "changeme";
   std::size_t history_on_join = 20;
+  std::size_t ring_size = 200;
+  std::size_t warm_cache_mb = 16;
+  std::size_t accept_shards = 1;
+  std::size_t listen_backlog = 128;
+
+  std::size_t ping_sec = 30;
+  std::size_t idle_timeout_sec = 90;
+  std::size_t hello_timeout_sec = 10;
 
   bool        enc_enabled = false;
   std::string enc_key_hex;
+
+  std::string node_id;
+  std::vector<std::string> peers;
+
+  std::string replicate_from;
+
+  std::size_t snapshot_sec = 60;
+
+  std::size_t retention_days = 0;
+  std::size_t retention_mb = 0;
+  std::size_t compact_check_sec = 300;
+  std::size_t compact_io_kbps = 4096;
+
+  std::size_t cpu_threads = 0;       // потоки пула хэширования/шифрования (0 — по числу ядер)
+
+  std::size_t mem_limit_mb = 512;     // общий лимит буферов и кэшей
+  std::size_t conn_mem_kb = 2048;    // лимит на одно подключение
+  std::size_t mem_wait_ms = 2000;    // сколько ждать освобождения памяти перед отключением
+
+  double      trace_rate = 0.0;   // доля сообщений в трассировке (0 — выключено)
+  std::size_t capture_mb = 0;     // запись входящих кадров для lanchat_replay (0 — выключено)
+  bool        capture_plaintext = false; // разрешить открытую запись при включённом шифровании лога
+  std::size_t attach_max_mb = 64; // максимальный размер вложения (0 — вложения выключены)
+  std::size_t attach_quota_mb = 4096;   // все вложения на диске вместе (0 — без ограничения)
+  std::size_t attach_partial_hours = 24; // брошенные незавершённые загрузки удаляются через столько часов
+  bool        attach_plaintext = false;  // разрешить вложения (они хранятся открыто) при шифровании лога
+
+  std::string mcast;              // group:port для рассылки MSG_BROADCAST по UDP multicast (пусто — выключено)
+  std::string mcast_if;           // IPv4 интерфейса для multicast (пусто — по таблице маршрутов)
+  std::size_t mcast_ttl = 1;
+  std::size_t mcast_mtu = 1500;   // MTU пути до клиентов; крупные сообщения идут через GAP_FETCH
+
+  std::string unix_socket;        // путь Unix-сокета для локальных ботов (пусто — выключено)
+  std::size_t shm_ring_kb = 4096; // кольцо в общей памяти для клиентов Unix-сокета (0 — выключено)
+
+  std::size_t batch_us = 1000;    // окно склейки MSG_BROADCAST при потоке сообщений (0 — писать каждый кадр сразу)
+  std::size_t batch_kb = 64;      // пачка уходит раньше окна, если набралось столько байт
+
+  std::size_t join_rate = 0;      // входов клиентов в секунду (0 — допуск выключен)
+  std::size_t join_burst = 100;   // сколько входов можно пропустить подряд без ожидания
+  std::size_t join_queue = 512;   // рукопожатий в очереди, сверх — BUSY сразу при accept (не больше, чем пройдёт за join_wait_ms)
+  std::size_t join_wait_ms = 5000; // сколько рукопожатие ждёт своей очереди до BUSY
 };
 
+std::string default_ini_path();
 void print_usage(const char* argv0);
 void parse_args(int argc, char** argv, Config& cfg);
 
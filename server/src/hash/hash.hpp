@@ -1,6 +1,7 @@
 #ifndef LANCHAT_HASH_HASH_HPP
 #define LANCHAT_HASH_HASH_HPP
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
@@ -9,6 +10,22 @@ namespace lanchat {
 uint64_t fnv1a64(const std::string& data);
 std::string hex64(uint64_t x);
 
+// SHA-256 для адресации вложений по содержимому (FNV слишком короткий для дедупликации).
+class Sha256 {
+public:
+  Sha256();
+  void update(const void* data, std::size_t n);
+  std::string hex_final();
+
+private:
+  void block(const uint8_t* p);
+
+  uint32_t h_[8];
+  uint8_t  buf_[64];
+  std::size_t buf_len_ = 0;
+  uint64_t total_ = 0;
+};
+
 }
 
 #endif
\ No newline at end of file
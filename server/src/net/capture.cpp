@@ -0,0 +1,126 @@
+#include "net/capture.hpp"
+#include "util/utils.hpp"
+
+#include <filesystem>
+#include <cstring>
+#include <chrono>
+
+namespace lanchat {
+
+static constexpr char     kCapMagic[4] = {'L','C','A','P'};
+static constexpr uint32_t kCapVersion  = 1;
+static constexpr size_t   kMaxPending  = 8u << 20;
+
+static uint64_t steady_us(){
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void put_varint(std::string& out, uint64_t v){
+  while (v >= 0x80){
+    out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+static bool get_varint(std::istream& in, uint64_t& v){
+  v = 0;
+  for (int shift = 0; shift < 64; shift += 7){
+    char c;
+    if (!in.get(c)) return false;
+    v |= static_cast<uint64_t>(static_cast<uint8_t>(c) & 0x7F) << shift;
+    if (!(static_cast<uint8_t>(c) & 0x80)) return true;
+  }
+  return false;
+}
+
+Capture::~Capture(){ close(); }
+
+bool Capture::open(const std::string& data_dir, std::size_t max_mb){
+  if (!max_mb) return false;
+  const auto p = std::filesystem::path(data_dir) / ("capture-" + std::to_string(now_ms()) + ".lcap");
+  std::string hdr(kCapMagic, 4);
+  uint32_t ver = to_be32(kCapVersion);
+  uint64_t start = to_be64(now_ms());
+  hdr.append(reinterpret_cast<const char*>(&ver), 4);
+  hdr.append(reinterpret_cast<const char*>(&start), 8);
+  {
+    std::lock_guard<std::mutex> lk(file_mx_);
+    out_.open(p.string(), std::ios::trunc | std::ios::binary);
+    if (!out_.is_open()) return false;
+    out_.write(hdr.data(), static_cast<std::streamsize>(hdr.size()));
+  }
+  std::lock_guard<std::mutex> lk(mx_);
+  last_us_ = steady_us();
+  written_ = hdr.size();
+  max_bytes_ = static_cast<uint64_t>(max_mb) << 20;
+  enabled_ = true;
+  return true;
+}
+
+void Capture::close(){
+  enabled_ = false;
+  flush();
+  std::lock_guard<std::mutex> lk(file_mx_);
+  if (out_.is_open()) out_.close();
+}
+
+void Capture::record(uint32_t conn, uint8_t type, const std::string& payload){
+  if (!enabled()) return;
+  std::lock_guard<std::mutex> lk(mx_);
+  const uint64_t now = steady_us();
+  const uint64_t size = pending_.size() + payload.size() + 24;
+  if (size > kMaxPending){ ++dropped_; return; }
+  if (written_ + size > max_bytes_){ enabled_ = false; return; }
+  put_varint(pending_, now - last_us_);
+  put_varint(pending_, conn);
+  pending_.push_back(static_cast<char>(type));
+  put_varint(pending_, payload.size());
+  pending_ += payload;
+  last_us_ = now;
+  ++records_;
+}
+
+void Capture::flush(){
+  std::string batch;
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    batch.swap(pending_);
+    written_ += batch.size();
+  }
+  if (batch.empty()) return;
+  std::lock_guard<std::mutex> lk(file_mx_);
+  if (!out_.is_open()) return;
+  out_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+  out_.flush();
+}
+
+bool CaptureReader::open(const std::string& path){
+  in_.open(path, std::ios::binary);
+  if (!in_.is_open()) return false;
+  char hdr[16];
+  if (!in_.read(hdr, sizeof(hdr)) || std::memcmp(hdr, kCapMagic, 4) != 0) return false;
+  uint32_t ver; std::memcpy(&ver, hdr + 4, 4);
+  if (from_be32(ver) != kCapVersion) return false;
+  uint64_t start; std::memcpy(&start, hdr + 8, 8);
+  start_ms_ = from_be64(start);
+  t_us_ = 0;
+  return true;
+}
+
+bool CaptureReader::next(CaptureRecord& rec){
+  uint64_t dt = 0, conn = 0, len = 0;
+  char type;
+  if (!get_varint(in_, dt) || !get_varint(in_, conn) || !in_.get(type) || !get_varint(in_, len)) return false;
+  if (len > (1u << 20)) return false;
+  rec.payload.resize(static_cast<size_t>(len));
+  if (len && !in_.read(&rec.payload[0], static_cast<std::streamsize>(len))) return false;
+  t_us_ += dt;
+  rec.t_us = t_us_;
+  rec.conn = static_cast<uint32_t>(conn);
+  rec.type = static_cast<uint8_t>(type);
+  return true;
+}
+
+}
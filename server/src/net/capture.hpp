@@ -0,0 +1,75 @@
+#ifndef LANCHAT_NET_CAPTURE_HPP
+#define LANCHAT_NET_CAPTURE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <atomic>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Запись входящего потока кадров клиентов в компактный бинарный файл
+ * <data>/capture-<ms>.lcap для последующего воспроизведения (lanchat_replay).
+ *
+ * Формат: "LCAP" + version u32 BE + wall-clock начала u64 BE, далее записи:
+ *   varint dt_us (от предыдущей записи), varint conn, type u8, varint len, payload.
+ * Первая запись соединения — HELLO; type kCaptureClose отмечает отключение.
+ */
+static constexpr uint8_t kCaptureClose = 0xFF;
+
+class Capture {
+public:
+  ~Capture();
+
+  bool open(const std::string& data_dir, std::size_t max_mb);
+  void close();
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  uint32_t next_conn() { return next_conn_.fetch_add(1); }
+  void record(uint32_t conn, uint8_t type, const std::string& payload);
+  void flush();
+
+  uint64_t records() const { return records_.load(); }
+  uint64_t dropped() const { return dropped_.load(); }
+
+private:
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint32_t> next_conn_{1};
+  std::atomic<uint64_t> records_{0};
+  std::atomic<uint64_t> dropped_{0};
+
+  std::mutex mx_;
+  std::string pending_;
+  uint64_t last_us_ = 0;
+  uint64_t written_ = 0;
+  uint64_t max_bytes_ = 0;
+
+  std::mutex file_mx_;
+  std::ofstream out_;
+};
+
+struct CaptureRecord {
+  uint64_t    t_us = 0;     // от начала записи
+  uint32_t    conn = 0;
+  uint8_t     type = 0;
+  std::string payload;
+};
+
+/** Последовательное чтение файла записи. */
+class CaptureReader {
+public:
+  bool open(const std::string& path);
+  bool next(CaptureRecord& rec);
+  uint64_t start_ms() const { return start_ms_; }
+
+private:
+  std::ifstream in_;
+  uint64_t start_ms_ = 0;
+  uint64_t t_us_ = 0;
+};
+
+}
+
+#endif
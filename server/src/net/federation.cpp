@@ -0,0 +1,155 @@
+#include "net/federation.hpp"
+#include "net/protocol.hpp"
+#include "hash/hash.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+
+namespace lanchat {
+
+static constexpr std::size_t kPeerQueueMax = 10000;
+static constexpr std::size_t kSeenMax      = 8192;
+
+Federation::Federation(const Config& cfg, UserRegistry& users, DeliverFn deliver)
+  : cfg_(cfg), users_(users), deliver_(std::move(deliver)) {
+  std::random_device rd;
+  const uint64_t nonce = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^ now_ms();
+  epoch_ = hex64(nonce);
+}
+
+Federation::~Federation(){ stop(); }
+
+void Federation::start(){
+  for (const auto& hp : cfg_.peers){
+    auto p = std::make_unique<Peer>();
+    if (!split_host_port(hp, p->host, p->port)){
+      std::cerr<<"Bad peer address: "<<hp<<"\n";
+      continue;
+    }
+    peers_.push_back(std::move(p));
+  }
+  for (auto& p : peers_){
+    Peer* raw = p.get();
+    raw->th = std::thread([this, raw]{ link_loop(raw); });
+  }
+}
+
+void Federation::stop(){
+  if (stop_.exchange(true)) return;
+  for (auto& p : peers_){
+    {
+      std::lock_guard<std::mutex> lk(p->mx);
+      if (p->sock != INVALID_SOCK) shutdown(p->sock, SHUT_RDWR);
+    }
+    p->cv.notify_all();
+  }
+  for (auto& p : peers_) if (p->th.joinable()) p->th.join();
+}
+
+bool Federation::remember(const std::string& id){
+  std::lock_guard<std::mutex> lk(seen_mx_);
+  if (!seen_.insert(id).second) return false;
+  seen_order_.push_back(id);
+  if (seen_order_.size() > kSeenMax){
+    seen_.erase(seen_order_.front());
+    seen_order_.pop_front();
+  }
+  return true;
+}
+
+void Federation::publish(const Message& m){
+  if (peers_.empty()) return;
+  const std::string id = cfg_.node_id + ":" + epoch_ + ":" + std::to_string(++counter_);
+  remember(id);
+  const std::string frame = PeerMsgFrame::encode(id, m.ts_ms, users_.name(m.user_id), m.text);
+  if (frame.empty()) return;
+  for (auto& p : peers_){
+    std::lock_guard<std::mutex> lk(p->mx);
+    if (p->queue.size() >= kPeerQueueMax) p->queue.pop_front();
+    p->queue.push_back(frame);
+    p->cv.notify_one();
+  }
+}
+
+void Federation::link_loop(Peer* p){
+  int backoff_ms = 200;
+  while (!stop_.load()){
+    socket_t s = connect_tcp(p->host, p->port);
+    if (s != INVALID_SOCK){
+      std::string hello = PeerHelloFrame::encode(cfg_.node_id, peer_auth_token(cfg_.node_id, cfg_.secret));
+      uint8_t hdr[wire::kHeaderSize];
+      bool ok = send_frame(s, PEER_HELLO, hello) && read_exact(s, hdr, sizeof(hdr)) && hdr[0] == OK;
+      if (ok){
+        std::cout<<"Peer link up: "<<p->host<<":"<<p->port<<"\n";
+        backoff_ms = 200;
+        const std::size_t ping_sec = cfg_.ping_sec ? cfg_.ping_sec : cfg_.idle_timeout_sec / 2;
+        auto ready = [&]{ return stop_.load() || !p->queue.empty(); };
+        std::unique_lock<std::mutex> lk(p->mx);
+        p->sock = s;
+        while (!stop_.load()){
+          if (!ping_sec) p->cv.wait(lk, ready);
+          else if (!p->cv.wait_for(lk, std::chrono::seconds(ping_sec), ready)){
+            lk.unlock();
+            const bool sent = send_frame(s, PING, "");
+            lk.lock();
+            if (!sent) break;
+            continue;
+          }
+          if (stop_.load()) break;
+          std::string frame = p->queue.front();
+          lk.unlock();
+          bool sent = send_frame(s, PEER_MSG, frame);
+          lk.lock();
+          if (!sent) break;
+          if (!p->queue.empty() && p->queue.front() == frame) p->queue.pop_front();
+        }
+        p->sock = INVALID_SOCK;
+        lk.unlock();
+        if (!stop_.load()) std::cerr<<"Peer link down: "<<p->host<<":"<<p->port<<"\n";
+      }
+      CLOSESOCK(s);
+    }
+    for (int waited = 0; waited < backoff_ms && !stop_.load(); waited += 50)
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    backoff_ms = backoff_ms < 5000 ? backoff_ms * 2 : 5000;
+  }
+}
+
+void Federation::serve_link(socket_t s, const std::string& hello, std::atomic<uint64_t>* last_rx){
+  PeerHelloFrame::View v;
+  if (!PeerHelloFrame::decode(hello, v)) v = {};
+  const std::string node(std::get<0>(v));
+  if (node.empty() || std::get<1>(v) != peer_auth_token(node, cfg_.secret)){
+    send_error(s, "Bad PEER_HELLO");
+    return;
+  }
+  if (node == cfg_.node_id){
+    send_error(s, "Self link");
+    return;
+  }
+  if (!send_ok(s)) return;
+
+  uint8_t hdr[wire::kHeaderSize];
+  while (!stop_.load()){
+    if (!read_exact(s, hdr, sizeof(hdr))) break;
+    const uint32_t plen = wire::parse_header(hdr).len;
+    if (plen > (1u<<20) + 1024) break;
+    std::string payload(plen, '\0');
+    if (plen && !read_exact(s, payload.data(), plen)) break;
+    if (last_rx) *last_rx = now_ms();
+    if (hdr[0] != PEER_MSG) continue;
+
+    PeerMsgFrame::View v;
+    if (!PeerMsgFrame::decode(payload, v)) continue;
+    const auto& [id, ts_ms, user, text] = v;
+    if (user.empty() || !remember(std::string(id))) continue;
+    Message m;
+    m.ts_ms = ts_ms;
+    m.text = std::string(text);
+    m.user_id = users_.intern(std::string(user));
+    deliver_(m);
+  }
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef LANCHAT_NET_FEDERATION_HPP
+#define LANCHAT_NET_FEDERATION_HPP
+
+#include "storage/storage.hpp"
+#include "config/config.hpp"
+#include "util/utils.hpp"
+
+#include <condition_variable>
+#include <unordered_set>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Федерация узлов: каждый узел пересылает свои локальные сообщения всем
+ * пирам из конфига по отдельному исходящему соединению (PEER_HELLO + поток
+ * PEER_MSG). Входящие линки приходят на обычный клиентский порт.
+ * ID сообщения = "<node_id>:<эпоха>:<счётчик>", повторы отбрасываются. Эпоха
+ * выбирается заново при каждом запуске: счётчик живёт только в памяти, и без неё
+ * пиры приняли бы новые сообщения перезапущенного узла за уже виденные.
+ * Исходящий линк в простое шлёт PING раз в ping_sec, чтобы принимающая
+ * сторона отличала живой, но тихий линк от оборванного.
+ */
+class Federation {
+public:
+  using DeliverFn = std::function<void(const Message&)>;
+
+  Federation(const Config& cfg, UserRegistry& users, DeliverFn deliver);
+  ~Federation();
+
+  void start();
+  void stop();
+
+  void publish(const Message& m);
+  // last_rx — отметка времени последнего кадра от пира (для idle-вытеснения).
+  void serve_link(socket_t s, const std::string& hello, std::atomic<uint64_t>* last_rx);
+
+private:
+  struct Peer {
+    std::string host;
+    uint16_t    port = 0;
+    std::mutex  mx;
+    std::condition_variable cv;
+    std::deque<std::string> queue;
+    socket_t    sock{INVALID_SOCK};
+    std::thread th;
+  };
+
+  void link_loop(Peer* p);
+  bool remember(const std::string& id);
+
+private:
+  Config cfg_;
+  UserRegistry& users_;
+  DeliverFn deliver_;
+  std::atomic<bool> stop_{false};
+  std::string epoch_;
+  std::atomic<uint64_t> counter_{0};
+
+  std::vector<std::unique_ptr<Peer>> peers_;
+
+  std::mutex seen_mx_;
+  std::unordered_set<std::string> seen_;
+  std::deque<std::string> seen_order_;
+};
+
+}
+
+#endif
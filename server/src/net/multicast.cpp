@@ -0,0 +1,71 @@
+#include "net/multicast.hpp"
+
+#include <iostream>
+
+namespace lanchat {
+
+Multicast::~Multicast(){ close(); }
+
+bool Multicast::open(const std::string& group_port, const std::string& iface, std::size_t ttl, std::size_t mtu){
+  if (group_port.empty()) return false;
+  if (mtu <= kIpUdpHeaders + 64){
+    std::cerr<<"mcast_mtu too small: "<<mtu<<"\n";
+    return false;
+  }
+  max_datagram_ = mtu - kIpUdpHeaders;
+  if (!split_host_port(group_port, group_, port_)){
+    std::cerr<<"Bad --mcast value (expected group:port): "<<group_port<<"\n";
+    return false;
+  }
+  dst_ = {};
+  dst_.sin_family = AF_INET;
+  dst_.sin_port = htons(port_);
+  if (inet_pton(AF_INET, group_.c_str(), &dst_.sin_addr) != 1 || (ntohl(dst_.sin_addr.s_addr) >> 28) != 0xE){
+    std::cerr<<"Not an IPv4 multicast group: "<<group_<<"\n";
+    return false;
+  }
+
+  std::unique_lock<std::shared_mutex> lk(mx_);
+  sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (sock_ == INVALID_SOCK) return false;
+  const unsigned char ttl8 = static_cast<unsigned char>(ttl ? ttl : 1);
+  const unsigned char loop = 1;   // клиенты на той же машине тоже получают рассылку
+  setsockopt(sock_, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl8, sizeof(ttl8));
+  setsockopt(sock_, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&loop, sizeof(loop));
+  if (!iface.empty()){
+    in_addr ifa{};
+    if (inet_pton(AF_INET, iface.c_str(), &ifa) != 1 ||
+        setsockopt(sock_, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&ifa, sizeof(ifa)) == SOCK_ERROR){
+      std::cerr<<"Cannot use multicast interface "<<iface<<"\n";
+      CLOSESOCK(sock_);
+      sock_ = INVALID_SOCK;
+      return false;
+    }
+  }
+  open_ = true;
+  return true;
+}
+
+void Multicast::close(){
+  std::unique_lock<std::shared_mutex> lk(mx_);
+  open_ = false;
+  if (sock_ == INVALID_SOCK) return;
+  CLOSESOCK(sock_);
+  sock_ = INVALID_SOCK;
+}
+
+bool Multicast::send(const std::string& frame){
+  if (frame.size() > max_datagram_){
+    ++oversize_;
+    return false;
+  }
+  std::shared_lock<std::shared_mutex> lk(mx_);
+  if (sock_ == INVALID_SOCK) return false;
+  const int r = sendto(sock_, frame.data(), static_cast<int>(frame.size()), 0,
+                       reinterpret_cast<const sockaddr*>(&dst_), sizeof(dst_));
+  if (r == SOCK_ERROR) return false;
+  ++sent_;
+  return true;
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef LANCHAT_NET_MULTICAST_HPP
+#define LANCHAT_NET_MULTICAST_HPP
+
+#include "util/utils.hpp"
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+namespace lanchat {
+
+/**
+ * Рассылка MSG_BROADCAST одной UDP-датаграммой в multicast-группу локальной сети
+ * вместо N одинаковых записей в TCP-сокеты.
+ *
+ * Датаграмма — обычный кадр (type + len + payload) с seq в конце payload.
+ * Датаграммы не больше MTU пути минус заголовки IP/UDP: фрагментированная теряется
+ * целиком при потере любого фрагмента. Потерянные датаграммы и сообщения крупнее
+ * предела клиент добирает по TCP кадром GAP_FETCH; MCAST_TAIL с последним
+ * отправленным seq уходит раз в секунду, чтобы потеря последних сообщений тоже
+ * была заметна.
+ */
+class Multicast {
+public:
+  static constexpr std::size_t kIpUdpHeaders = 28;
+
+  ~Multicast();
+
+  bool open(const std::string& group_port, const std::string& iface, std::size_t ttl, std::size_t mtu);
+  void close();
+  bool enabled() const { return open_.load(); }
+  std::size_t max_datagram() const { return max_datagram_; }
+
+  const std::string& group() const { return group_; }
+  uint16_t port() const { return port_; }
+
+  // false — датаграмма не ушла (слишком большая или ошибка сокета).
+  bool send(const std::string& frame);
+
+  uint64_t sent() const { return sent_.load(); }
+  uint64_t oversize() const { return oversize_.load(); }
+
+private:
+  // send() идёт из потоков клиентов под shared-блокировкой, close() ждёт их.
+  std::shared_mutex mx_;
+  socket_t    sock_ = INVALID_SOCK;
+  std::atomic<bool> open_{false};
+  std::size_t max_datagram_ = 0;
+  sockaddr_in dst_{};
+  std::string group_;
+  uint16_t    port_ = 0;
+  std::atomic<uint64_t> sent_{0};
+  std::atomic<uint64_t> oversize_{0};
+};
+
+}
+
+#endif
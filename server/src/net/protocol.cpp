@@ -1,38 +1,181 @@
 #include "net/protocol.hpp"
 #include "util/utils.hpp" 
+#include "hash/hash.hpp"
 
-#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+  #include <sys/uio.h>
+#endif
+#if defined(__linux__)
+  #include <fcntl.h>
+  #include <sys/sendfile.h>
+#endif
 
 namespace lanchat {
 
-bool send_frame(socket_t s, uint8_t type, const std::string& payload){
-  uint8_t hdr[5];
-  hdr[0] = type;
-  uint32_t len_be = to_be32((uint32_t)payload.size());
-  std::memcpy(hdr+1, &len_be, 4);
-  if (!write_exact(s, hdr, 5)) return false;
-  if (!payload.empty() && !write_exact(s, payload.data(), payload.size())) return false;
-  return true;
+bool write_gather(socket_t s, std::string_view a, std::string_view b){
+  if (b.empty()) return write_exact(s, a.data(), a.size());
+  if (a.empty()) return write_exact(s, b.data(), b.size());
+#ifdef _WIN32
+  WSABUF bufs[2] = { { static_cast<ULONG>(a.size()), const_cast<char*>(a.data()) },
+                     { static_cast<ULONG>(b.size()), const_cast<char*>(b.data()) } };
+  DWORD sent = 0;
+  if (WSASend(s, bufs, 2, &sent, 0, nullptr, nullptr) == SOCK_ERROR) return false;
+#else
+  iovec iov[2] = { { const_cast<char*>(a.data()), a.size() }, { const_cast<char*>(b.data()), b.size() } };
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  const ssize_t sent = sendmsg(s, &msg, MSG_NOSIGNAL);
+  if (sent < 0) return false;
+#endif
+  const size_t n = static_cast<size_t>(sent);
+  if (n < a.size()) return write_exact(s, a.data() + n, a.size() - n) && write_exact(s, b.data(), b.size());
+  return write_exact(s, b.data() + (n - a.size()), b.size() - (n - a.size()));
+}
+
+bool send_frame(socket_t s, uint8_t type, std::string_view payload){
+  // Заголовок и payload уходят вместе: отдельный 5-байтовый send с Nagle
+  // ждал бы ACK (до 40 мс на delayed ACK), а без Nagle — отдельным сегментом.
+  char hdr[wire::kHeaderSize];
+  wire::put_header(hdr, type, static_cast<uint32_t>(payload.size()));
+  return write_gather(s, std::string_view(hdr, sizeof(hdr)), payload);
+}
+
+void append_frame(std::string& out, uint8_t type, std::string_view payload){
+  const size_t at = out.size();
+  out.resize(at + wire::kHeaderSize + payload.size());
+  wire::Rest::put(wire::put_header(&out[at], type, static_cast<uint32_t>(payload.size())), payload);
 }
 
 bool send_ok(socket_t s){ return send_frame(s, OK, ""); }
 bool send_error(socket_t s, const std::string& err){ return send_frame(s, ERR, err); }
 
-std::string make_broadcast(uint64_t ts_ms, const std::string& user, const std::string& text){
-  const uint16_t ulen = (uint16_t)(user.size() > 65535 ? 65535 : user.size());
-  const uint32_t mlen = (uint32_t)text.size();
-  std::string payload;
-  payload.resize(8 + 2 + ulen + 4 + mlen);
-  size_t off=0;
-  uint64_t ts_be = to_be64(ts_ms);
-  uint16_t u_be  = to_be16(ulen);
-  uint32_t m_be  = to_be32(mlen);
-  std::memcpy(&payload[off], &ts_be, 8); off+=8;
-  std::memcpy(&payload[off], &u_be, 2);  off+=2;
-  std::memcpy(&payload[off], user.data(), ulen); off+=ulen;
-  std::memcpy(&payload[off], &m_be, 4); off+=4;
-  if (mlen) std::memcpy(&payload[off], text.data(), mlen);
-  return payload;
+#ifdef _WIN32
+NowaitSender::NowaitSender() : ev_(WSACreateEvent()) {}
+
+NowaitSender::~NowaitSender(){
+  reset();
+  if (ev_ != WSA_INVALID_EVENT) WSACloseEvent(ev_);
+}
+
+bool NowaitSender::send(socket_t s, uint8_t type, std::string_view payload){
+  if (ev_ == WSA_INVALID_EVENT) return false;
+  if (pending_){
+    DWORD n = 0, flags = 0;
+    // WSA_IO_INCOMPLETE: прошлый кадр всё ещё не ушёл — клиент не читает.
+    if (!WSAGetOverlappedResult(sock_, &ov_, &n, FALSE, &flags)) return false;
+    pending_ = false;
+    if (n != buf_.size()) return false;
+  }
+  buf_.clear();
+  append_frame(buf_, type, payload);
+  ov_ = WSAOVERLAPPED{};
+  ov_.hEvent = ev_;
+  sock_ = s;
+  WSABUF b{ static_cast<ULONG>(buf_.size()), buf_.data() };
+  DWORD sent = 0;
+  if (WSASend(s, &b, 1, &sent, 0, &ov_, nullptr) == 0) return sent == buf_.size();
+  if (WSAGetLastError() != WSA_IO_PENDING) return false;
+  pending_ = true;
+  return true;
+}
+
+void NowaitSender::reset(){
+  if (!pending_) return;
+  // buf_ нельзя освобождать, пока ядро не вернуло операцию.
+  CancelIoEx(reinterpret_cast<HANDLE>(sock_), &ov_);
+  DWORD n = 0, flags = 0;
+  WSAGetOverlappedResult(sock_, &ov_, &n, TRUE, &flags);
+  pending_ = false;
+}
+#else
+NowaitSender::NowaitSender() = default;
+NowaitSender::~NowaitSender() = default;
+
+bool NowaitSender::send(socket_t s, uint8_t type, std::string_view payload){
+  std::string frame;
+  append_frame(frame, type, payload);
+  const ssize_t r = ::send(s, frame.data(), frame.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+  // Буфер полон или ушла только часть кадра (поток уже не выровнен) —
+  // ждать нельзя, вызывающий закрывает соединение.
+  return r != SOCK_ERROR && static_cast<size_t>(r) == frame.size();
+}
+
+void NowaitSender::reset(){}
+#endif
+
+bool parse_hello(const std::string& payload, HelloInfo& out){
+  const size_t nul = payload.find('\0');
+  out.username = payload.substr(0, nul);
+  if (nul == std::string::npos) return true;
+
+  const char* p = payload.data() + nul + 1;
+  const char* end = payload.data() + payload.size();
+  while (p < end){
+    uint8_t type;
+    std::string_view value;
+    if (!wire::U8::get(p, end, type) || !wire::Str16::get(p, end, value)) return false;
+    if (type == HELLO_EXT_RESUME && value.size() == 8){
+      out.resume_seq = wire::load_be<uint64_t>(value.data());
+      out.resume = true;
+    } else if (type == HELLO_EXT_MCAST){
+      out.mcast = true;
+    } else if (type == HELLO_EXT_SHM){
+      out.shm = true;
+    }
+  }
+  return true;
+}
+
+bool send_file_frame(socket_t s, uint8_t type, std::string_view prefix,
+                     const std::string& path, uint64_t offset, uint32_t len){
+  std::string head(wire::kHeaderSize, '\0');
+  wire::put_header(&head[0], type, static_cast<uint32_t>(prefix.size() + len));
+  head.append(prefix.data(), prefix.size());
+#if defined(__linux__)
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  // MSG_MORE: заголовок уйдёт в одном сегменте с началом файла.
+  const ssize_t sent = send(s, head.data(), head.size(), MSG_NOSIGNAL | MSG_MORE);
+  bool ok = sent >= 0 && write_exact(s, head.data() + sent, head.size() - static_cast<size_t>(sent));
+  off_t pos = static_cast<off_t>(offset);
+  for (uint32_t left = len; ok && left; ){
+    const ssize_t r = ::sendfile(s, fd, &pos, left);
+    if (r <= 0){ ok = false; break; }
+    left -= static_cast<uint32_t>(r);
+  }
+  ::close(fd);
+  return ok;
+#else
+  std::ifstream in(path, std::ios::binary);
+  if (!in.seekg(static_cast<std::streamoff>(offset))) return false;
+  if (!write_exact(s, head.data(), head.size())) return false;
+  std::vector<char> buf(64 * 1024);
+  for (uint32_t left = len; left; ){
+    const uint32_t n = std::min<uint32_t>(left, static_cast<uint32_t>(buf.size()));
+    if (!in.read(buf.data(), n) || !write_exact(s, buf.data(), n)) return false;
+    left -= n;
+  }
+  return true;
+#endif
+}
+
+std::string attach_ref(const std::string& id, uint64_t size,
+                       const std::string& name, std::string_view caption){
+  std::string out = kAttachPrefix + id + ":" + std::to_string(size) + ":" + name;
+  if (!caption.empty()){
+    out += '\n';
+    out.append(caption.data(), caption.size());
+  }
+  return out;
+}
+
+std::string peer_auth_token(const std::string& node, const std::string& secret){
+  return hex64(fnv1a64(node + "|" + secret));
 }
 
 }
@@ -1,6 +1,7 @@
 #ifndef LANCHAT_NET_PROTOCOL_HPP
 #define LANCHAT_NET_PROTOCOL_HPP
 
+#include "net/wire.hpp"
 #include "util/utils.hpp"
 
 #include <string>
@@ -10,18 +11,137 @@ namespace lanchat {
 enum : uint8_t {
   HELLO = 0x01,
   MSG   = 0x02,
+  DM    = 0x03,
+  PING  = 0x07,
+  PONG  = 0x08,
   OK    = 0x06,
   ERR   = 0x05,
-  MSG_BROADCAST = 0x12
+  HISTORY     = 0x09,
+  HISTORY_END = 0x0A,
+  ATTACH_BEGIN = 0x0B,
+  ATTACH_ACK   = 0x0C,
+  ATTACH_CHUNK = 0x0D,
+  MSG_ATTACH   = 0x0E,
+  BLOB_GET     = 0x0F,
+  BLOB_DATA    = 0x10,
+  GAP_FETCH    = 0x11,
+  MSG_BROADCAST = 0x12,
+  MSG_DIRECT    = 0x13,
+  MCAST_INFO    = 0x14,
+  MCAST_TAIL    = 0x15,
+  SHM_INFO      = 0x16,
+  BUSY          = 0x17,
+
+  PEER_HELLO = 0x20,
+  PEER_MSG   = 0x21,
+
+  REPL_SUBSCRIBE = 0x22,
+  REPL_DATA      = 0x23,
+  REPL_HEARTBEAT = 0x24
+};
+
+// Флаги REPL_HEARTBEAT: что есть у лидера, но в поток репликации не входит.
+enum : uint8_t {
+  REPL_HAS_DMS   = 0x01,   // dms.log
+  REPL_HAS_BLOBS = 0x02    // вложения в blobs/
+};
+
+// Расширения HELLO: после username идёт байт 0, затем TLV (type u8, len u16, value).
+enum : uint8_t {
+  HELLO_EXT_RESUME = 0x01,  // u64: последний seq, полученный клиентом
+  HELLO_EXT_MCAST  = 0x02,  // пусто: клиент готов получать MSG_BROADCAST из multicast-группы
+  HELLO_EXT_SHM    = 0x03   // пусто: клиент Unix-сокета просит кольцо в общей памяти
+};
+
+struct HelloInfo {
+  std::string username;
+  bool        resume = false;
+  uint64_t    resume_seq = 0;
+  bool        mcast = false;
+  bool        shm = false;
 };
 
-bool send_frame(socket_t s, uint8_t type, const std::string& payload);
+// Схемы кадров. Поля перечислены в порядке следования на проводе.
+using BroadcastFrame     = wire::Frame<MSG_BROADCAST,  wire::U64, wire::Str16, wire::Bytes32,
+                                       wire::Opt<uint64_t>>;                  // ts, user, text, seq
+using DirectFrame        = wire::Frame<MSG_DIRECT,     wire::U64, wire::Str16, wire::Str16,
+                                       wire::Bytes32>;                        // ts, from, to, text
+using DmFrame            = wire::Frame<DM,             wire::Str16, wire::Rest>;  // to, text
+using HistoryFrame       = wire::Frame<HISTORY,        wire::U64, wire::Opt<uint16_t>>;  // before, limit
+using HistoryEndFrame    = wire::Frame<HISTORY_END,    wire::U32, wire::U64>; // count, cursor
+using AttachBeginFrame   = wire::Frame<ATTACH_BEGIN,   wire::Str16, wire::U64>;  // sha256, size
+using AttachAckFrame     = wire::Frame<ATTACH_ACK,     wire::Str16, wire::U64>;  // sha256, have
+using AttachChunkFrame   = wire::Frame<ATTACH_CHUNK,   wire::Str16, wire::U64, wire::U64,
+                                       wire::Rest>;                           // sha256, size, offset, data
+using MsgAttachFrame     = wire::Frame<MSG_ATTACH,     wire::Str16, wire::Str16, wire::Rest>;  // sha256, name, caption
+using BlobGetFrame       = wire::Frame<BLOB_GET,       wire::Str16, wire::U64>;  // sha256, offset
+using BlobDataHead       = wire::Frame<BLOB_DATA,      wire::Str16, wire::U64>;  // sha256, offset; дальше байты файла
+using GapFetchFrame      = wire::Frame<GAP_FETCH,      wire::U64, wire::U16>;    // after seq, count
+using McastInfoFrame     = wire::Frame<MCAST_INFO,     wire::Str16, wire::U16>;  // group, port
+using McastTailFrame     = wire::Frame<MCAST_TAIL,     wire::U64>;               // последний разосланный seq
+using ShmInfoFrame       = wire::Frame<SHM_INFO,       wire::U64>;               // capacity; fds — в SCM_RIGHTS
+using BusyFrame          = wire::Frame<BUSY,           wire::U32, wire::Rest>;   // retry_after_ms, причина
+using PeerHelloFrame     = wire::Frame<PEER_HELLO,     wire::Str16, wire::Rest>;  // node, token
+using PeerMsgFrame       = wire::Frame<PEER_MSG,       wire::Str16, wire::U64, wire::Str16,
+                                       wire::Bytes32>;                        // id, ts, user, text
+using ReplSubscribeFrame = wire::Frame<REPL_SUBSCRIBE, wire::Str16, wire::Str16, wire::U64>;  // node, token, offset
+using ReplDataFrame      = wire::Frame<REPL_DATA,      wire::U64, wire::Rest>;    // offset, log bytes
+using ReplHeartbeatFrame = wire::Frame<REPL_HEARTBEAT, wire::U64, wire::U64,
+                                       wire::Opt<uint8_t>>;                   // leader end, ts, REPL_HAS_*
+
+static_assert(HistoryEndFrame::kFixed && HistoryEndFrame::kMinSize == 12, "HISTORY_END layout");
+static_assert(ReplHeartbeatFrame::kMinSize == 16, "REPL_HEARTBEAT layout");
+static_assert(BroadcastFrame::kMinSize == 14, "MSG_BROADCAST layout");
+
+bool send_frame(socket_t s, uint8_t type, std::string_view payload);
+// Два буфера одним системным вызовом (sendmsg/WSASend), остаток дописывается.
+bool write_gather(socket_t s, std::string_view a, std::string_view b);
+void append_frame(std::string& out, uint8_t type, std::string_view payload);
 bool send_ok(socket_t s);
 bool send_error(socket_t s, const std::string& err);
 
-std::string make_broadcast(uint64_t ts_ms,
-                           const std::string& user,
-                           const std::string& text);
+bool parse_hello(const std::string& payload, HelloInfo& out);
+
+/**
+ * Отправка кадра без ожидания: false, если кадр не принят целиком.
+ * На POSIX это send с MSG_DONTWAIT. В Winsock такого флага нет, а включать
+ * FIONBIO на сокете, из которого в это же время блокирующе читает поток
+ * клиента, нельзя: его recv получит WSAEWOULDBLOCK. Поэтому там кадр уходит
+ * перекрывающимся WSASend из собственного буфера, и пока предыдущий кадр
+ * не ушёл, следующий не принимается. Вызовы сериализует владелец (wmx).
+ */
+class NowaitSender {
+public:
+  NowaitSender();
+  ~NowaitSender();
+  NowaitSender(const NowaitSender&) = delete;
+  NowaitSender& operator=(const NowaitSender&) = delete;
+
+  bool send(socket_t s, uint8_t type, std::string_view payload);
+  // Отменяет незавершённую отправку; вызывать до закрытия сокета.
+  void reset();
+
+private:
+#ifdef _WIN32
+  WSAOVERLAPPED ov_{};
+  WSAEVENT ev_ = WSA_INVALID_EVENT;
+  socket_t sock_ = INVALID_SOCK;
+  bool pending_ = false;
+  std::string buf_;
+#endif
+};
+
+// Кадр type с payload = prefix + len байт файла начиная с offset; байты файла
+// уходят в сокет через sendfile без копирования в память процесса.
+bool send_file_frame(socket_t s, uint8_t type, std::string_view prefix,
+                     const std::string& path, uint64_t offset, uint32_t len);
+
+// Ссылка на вложение в тексте сообщения: "attach:<sha256>:<size>:<name>" [+ "\n" + подпись].
+static constexpr char kAttachPrefix[] = "attach:";
+std::string attach_ref(const std::string& id, uint64_t size,
+                       const std::string& name, std::string_view caption);
+
+std::string peer_auth_token(const std::string& node, const std::string& secret);
 
 }
 
@@ -0,0 +1,197 @@
+#include "net/replication.hpp"
+#include "net/protocol.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+namespace lanchat {
+
+static constexpr std::size_t kReplChunk = 256 * 1024;
+static constexpr uint64_t    kHeartbeatMs = 1000;
+
+Replication::Replication(const Config& cfg, Storage& storage, Stats& stats, ApplyFn apply, LocalFn unreplicated)
+  : cfg_(cfg), storage_(storage), stats_(stats), apply_(std::move(apply)), unreplicated_(std::move(unreplicated)) {}
+
+Replication::~Replication(){ stop_follower(); }
+
+// Входящие кадры фоллоуера (PING) — только отметка, что он жив. Читаем то,
+// что уже пришло, не дожидаясь новых байт.
+static bool drain_input(socket_t s, std::atomic<uint64_t>* last_rx){
+  uint8_t hdr[wire::kHeaderSize];
+  while (readable_bytes(s) >= sizeof(hdr)){
+    if (!read_exact(s, hdr, sizeof(hdr))) return false;
+    const uint32_t len = wire::parse_header(hdr).len;
+    if (len > 1024) return false;
+    std::string skip(len, '\0');
+    if (len && !read_exact(s, skip.data(), len)) return false;
+    if (last_rx) *last_rx = now_ms();
+  }
+  return true;
+}
+
+void Replication::serve_follower(socket_t s, const std::string& subscribe, const std::atomic<bool>& stop,
+                                 std::atomic<uint64_t>* last_rx){
+  ReplSubscribeFrame::View v;
+  if (!ReplSubscribeFrame::decode(subscribe, v)) v = {};
+  const std::string node(std::get<0>(v));
+  uint64_t pos = std::get<2>(v);
+  if (node.empty() || std::get<1>(v) != peer_auth_token(node, cfg_.secret)){
+    send_error(s, "Bad REPL_SUBSCRIBE");
+    return;
+  }
+  if (following_.load()){
+    send_error(s, "Node is a follower");
+    return;
+  }
+  if (pos > storage_.log_offset()){
+    send_error(s, "Offset ahead of leader");
+    return;
+  }
+  if (pos < storage_.log_base()) pos = storage_.log_base();
+  if (!send_ok(s)) return;
+  std::cout<<"Replica "<<node<<" subscribed at offset "<<pos<<"\n";
+  stats_.add("repl_followers", 1);
+
+  std::string chunk;
+  uint64_t last_hb = 0;
+  while (!stop.load()){
+    if (!drain_input(s, last_rx)) break;
+    if (!storage_.read_log(pos, kReplChunk, chunk)) break;
+    if (!chunk.empty()){
+      if (!send_frame(s, REPL_DATA, ReplDataFrame::encode(pos, chunk))) break;
+      pos += chunk.size();
+      continue;
+    }
+    const uint64_t now = now_ms();
+    const uint64_t end = storage_.log_offset();
+    if (now - last_hb >= kHeartbeatMs){
+      const uint8_t flags = unreplicated_ ? unreplicated_() : 0;
+      if (!send_frame(s, REPL_HEARTBEAT, ReplHeartbeatFrame::encode(end, now, flags))) break;
+      last_hb = now;
+    }
+    // Пустой chunk при pos < end — в хвосте неполная строка: ждём роста лога,
+    // а не pos, иначе wait_log вернётся сразу и цикл будет крутиться вхолостую.
+    storage_.wait_log(std::max(pos, end), static_cast<int>(kHeartbeatMs));
+  }
+  stats_.add("repl_followers", -1);
+  std::cout<<"Replica "<<node<<" detached at offset "<<pos<<"\n";
+}
+
+void Replication::start_follower(){
+  if (cfg_.replicate_from.empty() || following_.exchange(true)) return;
+  stats_.set("repl_following", 1);
+  th_ = std::thread([this]{ follow_loop(); });
+}
+
+void Replication::stop_follower(){
+  if (!following_.exchange(false)) return;
+  {
+    std::lock_guard<std::mutex> lk(sock_mx_);
+    if (sock_ != INVALID_SOCK) shutdown(sock_, SHUT_RDWR);
+  }
+  if (th_.joinable()) th_.join();
+  stats_.set("repl_following", 0);
+  stats_.set("repl_connected", 0);
+}
+
+void Replication::update_lag(uint64_t applied){
+  const uint64_t now = now_ms();
+  if (leader_end_ > applied){
+    if (!behind_since_ms_) behind_since_ms_ = now;
+  } else {
+    behind_since_ms_ = 0;
+  }
+  stats_.set("repl_applied_offset", static_cast<int64_t>(applied));
+  stats_.set("repl_lag_bytes", static_cast<int64_t>(leader_end_ > applied ? leader_end_ - applied : 0));
+  stats_.set("repl_lag_ms", static_cast<int64_t>(behind_since_ms_ ? now - behind_since_ms_ : 0));
+}
+
+void Replication::follow_loop(){
+  std::string host; uint16_t port = 0;
+  if (!split_host_port(cfg_.replicate_from, host, port)){
+    std::cerr<<"Bad leader address: "<<cfg_.replicate_from<<"\n";
+    return;
+  }
+
+  while (following_.load()){
+    socket_t s = connect_tcp(host, port);
+    if (s != INVALID_SOCK){
+      {
+        std::lock_guard<std::mutex> lk(sock_mx_);
+        sock_ = s;
+      }
+      uint64_t applied = storage_.log_offset();
+      std::string sub = ReplSubscribeFrame::encode(cfg_.node_id,
+                                                   peer_auth_token(cfg_.node_id, cfg_.secret),
+                                                   applied);
+      uint8_t hdr[wire::kHeaderSize];
+      bool ok = following_.load() && send_frame(s, REPL_SUBSCRIBE, sub) && read_exact(s, hdr, sizeof(hdr));
+      if (ok && hdr[0] != OK){
+        std::string err(std::min<uint32_t>(wire::parse_header(hdr).len, 1024), '\0');
+        if (!err.empty()) read_exact(s, err.data(), err.size());
+        std::cerr<<"Leader refused replication: "<<err<<"\n";
+        ok = false;
+      }
+      if (ok){
+        std::cout<<"Following leader "<<cfg_.replicate_from<<" from offset "<<applied<<"\n";
+        stats_.set("repl_connected", 1);
+        // Лидер шлёт heartbeat раз в секунду: тишина дольше idle_timeout — обрыв.
+        if (cfg_.idle_timeout_sec) set_recv_timeout(s, static_cast<uint32_t>(cfg_.idle_timeout_sec * 1000));
+        std::vector<Message> parsed;
+        uint64_t last_ping = now_ms();
+        while (following_.load() && read_exact(s, hdr, sizeof(hdr))){
+          const uint32_t plen = wire::parse_header(hdr).len;
+          if (plen > (8u<<20)) break;
+          std::string payload(plen, '\0');
+          if (plen && !read_exact(s, payload.data(), plen)) break;
+          // PING и во время догоняния: REPL_HEARTBEAT тогда не приходят, а лидер
+          // вытесняет реплику, от которой ничего не слышно.
+          if (now_ms() - last_ping >= kHeartbeatMs){
+            if (!send_frame(s, PING, "")) break;
+            last_ping = now_ms();
+          }
+
+          if (hdr[0] == REPL_DATA){
+            ReplDataFrame::View data;
+            if (!ReplDataFrame::decode(payload, data)) break;
+            const auto& [pos, log] = data;
+            if (pos < applied) break;
+            if (pos > applied){
+              std::cerr<<"Leader compacted past offset "<<applied<<", restarting the local log at "<<pos<<"\n";
+              if (!storage_.skip_to(pos)){
+                std::cerr<<"Cannot restart the local log\n";
+                break;
+              }
+              applied = pos;
+            }
+            parsed.clear();
+            if (!storage_.append_raw(std::string(log), parsed)) break;
+            applied = storage_.log_offset();
+            if (leader_end_ < applied) leader_end_ = applied;
+            if (!parsed.empty()) apply_(parsed);
+            update_lag(applied);
+          } else if (hdr[0] == REPL_HEARTBEAT){
+            ReplHeartbeatFrame::View hb;
+            if (!ReplHeartbeatFrame::decode(payload, hb)) break;
+            leader_end_ = std::get<0>(hb);
+            leader_unreplicated_ = std::get<2>(hb);
+            stats_.set("repl_leader_unreplicated", std::get<2>(hb));
+            update_lag(applied);
+          }
+        }
+        stats_.set("repl_connected", 0);
+        if (following_.load()) std::cerr<<"Replication stream lost, reconnecting\n";
+      }
+      {
+        std::lock_guard<std::mutex> lk(sock_mx_);
+        sock_ = INVALID_SOCK;
+      }
+      CLOSESOCK(s);
+    }
+    for (int waited = 0; waited < 1000 && following_.load(); waited += 50)
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
+
+}
@@ -0,0 +1,69 @@
+#ifndef LANCHAT_NET_REPLICATION_HPP
+#define LANCHAT_NET_REPLICATION_HPP
+
+#include "storage/storage.hpp"
+#include "config/config.hpp"
+#include "stats/stats.hpp"
+#include "util/utils.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Репликация лога на тёплый резерв.
+ * Лидер: на REPL_SUBSCRIBE(offset) отдаёт хвост messages.log кадрами REPL_DATA
+ * и раз в секунду шлёт REPL_HEARTBEAT со своим концом лога.
+ * Фоллоуер отвечает PING не реже раза в секунду и рвёт поток, если от лидера
+ * ничего не было idle_timeout_sec; лидер так же закрывает молчащую реплику.
+ * Фоллоуер: держит байт-в-байт копию лога, поэтому его offset = размер своего лога.
+ * Личные сообщения и вложения не реплицируются: лидер сообщает об их наличии
+ * в REPL_HEARTBEAT, и повышение такого фоллоуера требует явного force.
+ */
+class Replication {
+public:
+  using ApplyFn = std::function<void(const std::vector<Message>&)>;
+  using LocalFn = std::function<uint8_t()>;   // REPL_HAS_* этого узла
+
+  Replication(const Config& cfg, Storage& storage, Stats& stats, ApplyFn apply, LocalFn unreplicated);
+  ~Replication();
+
+  // last_rx — отметка времени последнего кадра от фоллоуера (для idle-вытеснения).
+  void serve_follower(socket_t s, const std::string& subscribe, const std::atomic<bool>& stop,
+                      std::atomic<uint64_t>* last_rx);
+
+  void start_follower();
+  void stop_follower();
+  bool following() const { return following_.load(); }
+  // REPL_HAS_* из последнего heartbeat лидера: чего у этого узла нет.
+  uint8_t leader_unreplicated() const { return leader_unreplicated_.load(); }
+
+private:
+  void follow_loop();
+  void update_lag(uint64_t applied);
+
+private:
+  Config cfg_;
+  Storage& storage_;
+  Stats& stats_;
+  ApplyFn apply_;
+  LocalFn unreplicated_;
+
+  std::atomic<bool> following_{false};
+  std::thread th_;
+  std::mutex sock_mx_;
+  socket_t sock_{INVALID_SOCK};
+
+  std::atomic<uint8_t> leader_unreplicated_{0};
+  uint64_t leader_end_ = 0;
+  uint64_t behind_since_ms_ = 0;
+};
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "hash/hash.hpp"
 
 #include <filesystem>
+#include <fstream>
 #include <algorithm>
 #include <iostream>
 #include <cstring>
@@ -13,12 +14,51 @@
 
 #ifdef _WIN32
   #include <windows.h>
+#else
+  #include <sys/un.h>
+  #include <netinet/tcp.h>
 #endif
 
 namespace lanchat {
 
+Server::Counters::Counters(Stats& s)
+  : messages_total(s.counter("messages_total")),
+    join_busy_queue(s.counter("join_busy_queue")), join_busy_timeout(s.counter("join_busy_timeout")),
+    join_admitted(s.counter("join_admitted")), join_wait_ms_total(s.counter("join_wait_ms_total")),
+    shm_clients(s.counter("shm_clients")), shm_lagging(s.counter("shm_lagging")),
+    tx_batches(s.counter("tx_batches")), tx_batched_frames(s.counter("tx_batched_frames")),
+    mem_conn_rejects(s.counter("mem_conn_rejects")), mem_global_rejects(s.counter("mem_global_rejects")),
+    resume_ok(s.counter("resume_ok")), resume_miss(s.counter("resume_miss")),
+    mcast_gap_fetches(s.counter("mcast_gap_fetches")), mcast_gap_misses(s.counter("mcast_gap_misses")),
+    dm_total(s.counter("dm_total")), dm_store_failed(s.counter("dm_store_failed")),
+    attach_messages(s.counter("attach_messages")), attach_bytes_in(s.counter("attach_bytes_in")),
+    attach_bytes_out(s.counter("attach_bytes_out")), attach_quota_rejects(s.counter("attach_quota_rejects")),
+    attach_mismatch(s.counter("attach_mismatch")),
+    evicted_send_failed(s.counter("evicted_send_failed")), evicted_hello_timeout(s.counter("evicted_hello_timeout")),
+    evicted_idle(s.counter("evicted_idle")), evicted_ping_failed(s.counter("evicted_ping_failed")),
+    evicted_mem_budget(s.counter("evicted_mem_budget")) {}
+
+// Дальше этого RESUME не догоняет: клиент получает обычную историю при входе.
+static constexpr std::size_t kResumeMax = 2000;
+
 Server::Server(const Config& cfg)
-  : cfg_(cfg), storage_(/*last_cap*/200) {}
+  : cfg_(cfg), pool_(cfg.cpu_threads), storage_(cfg.ring_size ? cfg.ring_size : 1, users_),
+    federation_(cfg, users_, [this](const Message& m){
+      TraceMessage trace(&tracer_, "remote_message");
+      deliver(m);
+    }),
+    replication_(cfg, storage_, stats_, [this](const std::vector<Message>& ms){
+      ctr_.messages_total.add(static_cast<int64_t>(ms.size()));
+    }, [this]{
+      return static_cast<uint8_t>((storage_.has_direct() ? REPL_HAS_DMS : 0) |
+                                  (blobs_.enabled() && blobs_.used() ? REPL_HAS_BLOBS : 0));
+    }),
+    compactor_(cfg, storage_, stats_, [this]{
+      snapshot_offset_ = UINT64_MAX;
+      if (cfg_.snapshot_sec) write_snapshot();
+    }) {
+  storage_.set_on_commit([this](const Message& m, uint64_t trace){ broadcast(m, trace); });
+}
 
 Server::~Server(){ stop(); }
 
@@ -41,155 +81,936 @@ bool Server::start(){
     storage_.enable_encryption(key32);
   }
 
-  {
-    std::filesystem::create_directories(cfg_.data_dir);
-    std::filesystem::path up = std::filesystem::path(cfg_.data_dir) / "users.log";
-    users_log_.open(up.string(), std::ios::app);
+  users_.open(cfg_.data_dir);
+  storage_.set_warm_budget(cfg_.warm_cache_mb << 20);
+  mem_.set_limit(cfg_.mem_limit_mb ? static_cast<uint64_t>(cfg_.mem_limit_mb) << 20 : UINT64_MAX);
+  if (cfg_.mem_limit_mb && cfg_.mem_limit_mb <= cfg_.warm_cache_mb)
+    std::cerr<<"Warning: mem_limit_mb leaves no room beyond the warm cache\n";
+  if (cfg_.enc_enabled){
+    pool_.start();
+    storage_.set_pool(&pool_);
+  }
+  if (mcast_.open(cfg_.mcast, cfg_.mcast_if, cfg_.mcast_ttl, cfg_.mcast_mtu)){
+    std::cout<<"Multicasting broadcasts to "<<cfg_.mcast<<"\n";
+  }
+  join_.configure(static_cast<double>(cfg_.join_rate), cfg_.join_burst, cfg_.join_queue, cfg_.join_wait_ms);
+  if (cfg_.attach_max_mb && cfg_.enc_enabled && !cfg_.attach_plaintext){
+    std::cerr<<"Warning: attachments disabled: blobs are stored unencrypted while the log is"
+             <<" (pass --attach-plaintext to enable them anyway)\n";
+  } else if (blobs_.open(cfg_.data_dir, static_cast<uint64_t>(cfg_.attach_max_mb) << 20,
+                         static_cast<uint64_t>(cfg_.attach_quota_mb) << 20) && cfg_.enc_enabled){
+    std::cerr<<"Warning: attachments are NOT encrypted at rest\n";
+  }
+  if (cfg_.capture_mb && cfg_.enc_enabled && !cfg_.capture_plaintext){
+    // Запись хранит тексты сообщений открыто — рядом с зашифрованным логом это утечка.
+    std::cerr<<"Warning: capture disabled: .lcap files are not encrypted while the log is"
+             <<" (pass --capture-plaintext to record anyway)\n";
+  } else if (capture_.open(cfg_.data_dir, cfg_.capture_mb)){
+    std::cout<<"Capturing inbound frames (up to "<<cfg_.capture_mb<<" MB) into "<<cfg_.data_dir<<"\n";
+    std::cerr<<"Warning: capture files are NOT encrypted and hold message text in the clear\n";
+  }
+  if (tracer_.open(cfg_.data_dir, cfg_.trace_rate)){
+    storage_.set_tracer(&tracer_);
+    std::cout<<"Tracing "<<cfg_.trace_rate * 100<<"% of messages into "<<cfg_.data_dir<<"\n";
   }
 
-  storage_.load_from_log(/*max_lines*/2000, users_);
-
-  srv_ = socket(AF_INET, SOCK_STREAM, 0);
-  if (srv_ == INVALID_SOCK){ std::cerr<<"socket() failed\n"; return false; }
-
-  int yes=1;
-  setsockopt(srv_, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
+  {
+    const uint64_t t0 = now_ms();
+    if (!storage_.load_snapshot()) storage_.load_from_log(cfg_.ring_size);
+    users_.flush();
+    stats_.set("startup_load_ms", static_cast<int64_t>(now_ms() - t0));
+    if (storage_.warming()) std::cout<<"Decrypting history in the background; clients see it as it loads\n";
+  }
 
   sockaddr_in addr{}; addr.sin_family = AF_INET; addr.sin_port = htons(cfg_.port);
   if (inet_pton(AF_INET, cfg_.bind_addr.c_str(), &addr.sin_addr) != 1){
     std::cerr<<"Bad bind address\n"; return false;
   }
-  if (bind(srv_, (sockaddr*)&addr, sizeof(addr)) == SOCK_ERROR){
-    std::cerr<<"bind() failed: "<<GET_LAST_SOCK_ERR<<"\n"; return false;
+
+  const std::size_t shards = cfg_.accept_shards ? cfg_.accept_shards : 1;
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+  const std::size_t nlisteners = shards;
+#else
+  const std::size_t nlisteners = 1;
+#endif
+  if (nlisteners > 1 && !port_is_free(addr)){
+    // С SO_REUSEPORT второй экземпляр молча делил бы порт с первым.
+    std::cerr<<"Port "<<cfg_.port<<" is already in use by another process\n";
+    return false;
   }
-  if (listen(srv_, 16) == SOCK_ERROR){
-    std::cerr<<"listen() failed\n"; return false;
+  for (std::size_t i = 0; i < nlisteners; ++i){
+    socket_t ls = open_listener(addr, nlisteners > 1);
+    if (ls == INVALID_SOCK) return false;
+    listeners_.push_back(ls);
   }
-
 #ifndef _WIN32
   std::signal(SIGINT, [](int){ /* noop */ });
   std::signal(SIGTERM, [](int){ /* noop */ });
 #endif
 
-  std::thread([this]{ accept_loop(); }).detach();
+  for (std::size_t i = 0; i < shards; ++i){
+    socket_t ls = listeners_[i % listeners_.size()];
+    std::thread([this, ls, i]{ accept_loop(ls, stats_.counter("accepted_shard_" + std::to_string(i)), false); }).detach();
+  }
+  if (!cfg_.unix_socket.empty()){
+    socket_t ls = open_unix_listener(cfg_.unix_socket);
+    if (ls != INVALID_SOCK){
+      listeners_.push_back(ls);
+      std::thread([this, ls]{ accept_loop(ls, stats_.counter("accepted_unix"), true); }).detach();
+      std::cout<<"Local clients: unix socket "<<cfg_.unix_socket
+               <<(cfg_.shm_ring_kb ? " (shm ring " + std::to_string(cfg_.shm_ring_kb) + " KB)" : "")<<"\n";
+    }
+  }
+  timers_.start();
+  compactor_.start();
+  housekeeping_ = std::thread([this]{ housekeeping_loop(); });
+  if (cfg_.batch_us) flusher_ = std::thread([this]{ flush_loop(); });
+  if (!cfg_.replicate_from.empty()) replication_.start_follower();
+  else federation_.start();
   std::cout<<"Server listening on "<<cfg_.bind_addr<<":"<<cfg_.port
            <<" | data="<<cfg_.data_dir
+           <<" | shards="<<shards<<"x"<<listeners_.size()<<" backlog="<<cfg_.listen_backlog
+           <<" | node="<<cfg_.node_id
+           <<(cfg_.peers.empty() ? "" : " | peers="+std::to_string(cfg_.peers.size()))
+           <<(replication_.following() ? " | follower of "+cfg_.replicate_from : "")
            <<(cfg_.enc_enabled ? " | log-encryption=AES-GCM" : "") << "\n";
   return true;
 }
 
 void Server::stop(){
   if (stop_.exchange(true)) return;
-  if (srv_!=INVALID_SOCK){ CLOSESOCK(srv_); srv_=INVALID_SOCK; }
+  for (socket_t ls : listeners_){
+    shutdown(ls, SHUT_RDWR);
+    CLOSESOCK(ls);
+  }
+  listeners_.clear();
+#ifndef _WIN32
+  if (!cfg_.unix_socket.empty()) ::unlink(cfg_.unix_socket.c_str());
+#endif
+  replication_.stop_follower();
+  federation_.stop();
+  timers_.stop();
+  compactor_.stop();
+  if (housekeeping_.joinable()) housekeeping_.join();
+  { std::lock_guard<std::mutex> lk(flush_mx_); }
+  flush_cv_.notify_all();
+  if (flusher_.joinable()) flusher_.join();
+  mcast_.close();
+  storage_.stop_warmup();
+  pool_.stop();
+  storage_.drain();
+  if (cfg_.snapshot_sec) write_snapshot();
+  users_.flush();
+  tracer_.close();
+  capture_.close();
 #ifdef _WIN32
   WSACleanup();
 #endif
 }
 
-void Server::accept_loop(){
+bool Server::promote(bool force){
+  if (!replication_.following()) return false;
+  const uint8_t lost = replication_.leader_unreplicated();
+  if (lost && !force){
+    std::cerr<<"Refusing to promote: the leader holds"
+             <<(lost & REPL_HAS_DMS ? " direct messages" : "")
+             <<(lost & REPL_HAS_DMS && lost & REPL_HAS_BLOBS ? " and" : "")
+             <<(lost & REPL_HAS_BLOBS ? " attachments" : "")
+             <<" that are not replicated; write \"force\" into the promote file to accept losing them\n";
+    return false;
+  }
+  replication_.stop_follower();
+  cfg_.replicate_from.clear();
+  federation_.start();
+  std::cout<<"Promoted to leader at log offset "<<storage_.log_offset()<<"\n";
+  return true;
+}
+
+void Server::housekeeping_loop(){
+  const std::string stats_path = (std::filesystem::path(cfg_.data_dir) / "stats.txt").string();
+  uint64_t last_dump = 0;
+  uint64_t last_tail = 0;
+  uint64_t last_snap = now_ms();
+  uint64_t last_sweep = 0;
+  while(!stop_.load()){
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const uint64_t now = now_ms();
+    users_.flush();
+    tracer_.flush();
+    capture_.flush();
+    if (mcast_.enabled() && mcast_seq_.load() && now - last_tail >= 1000){
+      std::string tail;
+      McastTailFrame::append(tail, mcast_seq_.load());
+      mcast_.send(tail);
+      last_tail = now;
+    }
+    if (blobs_.enabled() && cfg_.attach_partial_hours && now - last_sweep >= 60000){
+      stats_.add("attach_partial_swept", static_cast<int64_t>(blobs_.sweep_partial(cfg_.attach_partial_hours * 3600)));
+      last_sweep = now;
+    }
+    if (cfg_.snapshot_sec && now - last_snap >= cfg_.snapshot_sec * 1000){
+      write_snapshot();
+      last_snap = now;
+    }
+    if (now - last_dump >= 2000){
+      {
+        std::lock_guard<std::mutex> lk(clients_mx_);
+        stats_.set("clients", static_cast<int64_t>(clients_.size()));
+        uint64_t peak = 0;
+        int64_t mcast_clients = 0;
+        for (const auto& c : clients_){
+          peak = std::max(peak, c->mem_peak.load());
+          mcast_clients += c->mcast;
+        }
+        stats_.set("mem_conn_peak_bytes", static_cast<int64_t>(peak));
+        if (mcast_.enabled()) stats_.set("mcast_clients", mcast_clients);
+      }
+      stats_.set("log_offset", static_cast<int64_t>(storage_.log_offset()));
+      stats_.set("users", static_cast<int64_t>(users_.size()));
+      stats_.set("timers", static_cast<int64_t>(timers_.size()));
+      stats_.set("warm_blocks", static_cast<int64_t>(storage_.warm().blocks()));
+      stats_.set("warm_cache_bytes", static_cast<int64_t>(storage_.warm().cache_bytes()));
+      stats_.set("warm_hits", static_cast<int64_t>(storage_.warm().hits()));
+      stats_.set("warm_misses", static_cast<int64_t>(storage_.warm().misses()));
+      stats_.set("append_inflight", static_cast<int64_t>(storage_.inflight()));
+      stats_.set("history_warming", storage_.warming() ? 1 : 0);
+      if (join_.enabled()) stats_.set("join_queued", static_cast<int64_t>(join_.queued()));
+      if (storage_.warm_ms()) stats_.set("history_warm_ms", static_cast<int64_t>(storage_.warm_ms()));
+      if (pool_.running()) stats_.set("pool_steals", static_cast<int64_t>(pool_.steals()));
+      mem_.set(MemBudget::kRing, storage_.ring_bytes());
+      mem_.set(MemBudget::kWarm, storage_.warm().cache_bytes());
+      stats_.set("mem_rx_bytes", static_cast<int64_t>(mem_.used(MemBudget::kRx)));
+      stats_.set("mem_tx_bytes", static_cast<int64_t>(mem_.used(MemBudget::kTx)));
+      stats_.set("mem_ring_bytes", static_cast<int64_t>(mem_.used(MemBudget::kRing)));
+      stats_.set("mem_warm_bytes", static_cast<int64_t>(mem_.used(MemBudget::kWarm)));
+      stats_.set("mem_total_bytes", static_cast<int64_t>(mem_.total()));
+      stats_.set("mem_limit_bytes", static_cast<int64_t>(mem_.limit()));
+      if (capture_.records()){
+        stats_.set("capture_records", static_cast<int64_t>(capture_.records()));
+        stats_.set("capture_dropped", static_cast<int64_t>(capture_.dropped()));
+      }
+      if (mcast_.enabled()){
+        stats_.set("mcast_sent", static_cast<int64_t>(mcast_.sent()));
+        stats_.set("mcast_oversize", static_cast<int64_t>(mcast_.oversize()));
+      }
+      if (blobs_.enabled()){
+        stats_.set("attach_stored", static_cast<int64_t>(blobs_.stored()));
+        stats_.set("attach_dedup", static_cast<int64_t>(blobs_.dedup_hits()));
+        stats_.set("attach_used_bytes", static_cast<int64_t>(blobs_.used()));
+      }
+      if (tracer_.enabled()) stats_.set("trace_events", static_cast<int64_t>(tracer_.events()));
+      stats_.write_file(stats_path);
+      last_dump = now;
+    }
+  }
+}
+
+void Server::write_snapshot(){
+  std::lock_guard<std::mutex> lk(snapshot_mx_);
+  const uint64_t offset = storage_.log_offset();
+  if (snapshot_offset_ == offset) return;
+  // Кольцо ещё догружается: снапшот с неполным кольцом отложим.
+  if (storage_.warming()) return;
+  const uint64_t t0 = now_ms();
+  if (!storage_.save_snapshot()){
+    std::cerr<<"Snapshot write failed\n";
+    return;
+  }
+  snapshot_offset_ = offset;
+  stats_.set("snapshot_ms", static_cast<int64_t>(now_ms() - t0));
+  stats_.set("snapshot_offset", static_cast<int64_t>(offset));
+}
+
+bool Server::port_is_free(const sockaddr_in& addr){
+  // Пробная привязка без SO_REUSEPORT не пройдёт, если порт уже кто-то слушает.
+  socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s == INVALID_SOCK) return false;
+  int yes=1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
+  const bool ok = bind(s, (const sockaddr*)&addr, sizeof(addr)) != SOCK_ERROR;
+  CLOSESOCK(s);
+  return ok;
+}
+
+socket_t Server::open_listener(const sockaddr_in& addr, bool reuse_port){
+  socket_t ls = socket(AF_INET, SOCK_STREAM, 0);
+  if (ls == INVALID_SOCK){ std::cerr<<"socket() failed\n"; return INVALID_SOCK; }
+
+  int yes=1;
+  setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, (char*)&yes, sizeof(yes));
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+  if (reuse_port && setsockopt(ls, SOL_SOCKET, SO_REUSEPORT, (char*)&yes, sizeof(yes)) == SOCK_ERROR){
+    std::cerr<<"SO_REUSEPORT failed: "<<GET_LAST_SOCK_ERR<<"\n";
+  }
+#endif
+
+  if (bind(ls, (const sockaddr*)&addr, sizeof(addr)) == SOCK_ERROR){
+    std::cerr<<"bind() failed: "<<GET_LAST_SOCK_ERR<<"\n"; CLOSESOCK(ls); return INVALID_SOCK;
+  }
+  if (listen(ls, static_cast<int>(cfg_.listen_backlog)) == SOCK_ERROR){
+    std::cerr<<"listen() failed\n"; CLOSESOCK(ls); return INVALID_SOCK;
+  }
+  return ls;
+}
+
+socket_t Server::open_unix_listener(const std::string& path){
+#ifdef _WIN32
+  std::cerr<<"unix_socket is not supported on this platform\n";
+  return INVALID_SOCK;
+#else
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)){
+    std::cerr<<"unix_socket path too long: "<<path<<"\n";
+    return INVALID_SOCK;
+  }
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  std::error_code ec;
+  if (std::filesystem::is_socket(path, ec)) std::filesystem::remove(path, ec);   // остался от прошлого запуска
+
+  socket_t ls = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ls == INVALID_SOCK) return INVALID_SOCK;
+  if (bind(ls, (sockaddr*)&addr, sizeof(addr)) == SOCK_ERROR ||
+      listen(ls, static_cast<int>(cfg_.listen_backlog)) == SOCK_ERROR){
+    std::cerr<<"Cannot listen on unix socket "<<path<<"\n";
+    CLOSESOCK(ls);
+    return INVALID_SOCK;
+  }
+  return ls;
+#endif
+}
+
+void Server::accept_loop(socket_t ls, Stats::Counter accepted, bool local){
   while(!stop_.load()){
-    sockaddr_in caddr{}; socklen_t clen=sizeof(caddr);
-    socket_t cs = accept(srv_, (sockaddr*)&caddr, &clen);
+    socket_t cs = accept(ls, nullptr, nullptr);
     if (cs==INVALID_SOCK){
       if (stop_.load()) break;
       continue;
     }
+    accepted.add(1);
+    if (join_.enabled() && !join_.enter()){
+      // Очередь рукопожатий полна: отказ до создания потока и чтения HELLO.
+      ctr_.join_busy_queue.add(1);
+      NowaitSender busy;
+      busy.send(cs, BUSY, BusyFrame::encode(join_.retry_after_ms(), "Server busy"));
+      busy.reset();
+      CLOSESOCK(cs);
+      continue;
+    }
+    if (!local){
+      // Мелкие кадры сервер склеивает сам (queue_broadcast), Nagle только добавил бы задержку.
+      int one = 1;
+      setsockopt(cs, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+    }
     auto cli = std::make_shared<ClientConn>();
     cli->sock = cs;
+    cli->local = local;
+    cli->join_pending = join_.enabled();
+    std::thread(client_thread, this, cli).detach();
+  }
+}
+
+bool Server::send_to(ClientConn& c, uint8_t type, const std::string& payload){
+  std::lock_guard<std::mutex> lk(c.wmx);
+  if (c.shm) return c.shm->push_frame(type, payload, static_cast<int>(cfg_.mem_wait_ms));
+  if (c.outq.empty()) return send_frame(c.sock, type, payload);
+  append_frame(c.outq, type, payload);
+  ++c.out_frames;
+  return flush_out(c);
+}
+
+bool Server::write_to(ClientConn& c, const char* data, std::size_t n){
+  if (c.shm) return c.shm->push(data, n, static_cast<int>(cfg_.mem_wait_ms));
+  if (c.outq.empty()) return write_exact(c.sock, data, n);
+  // Отложенные кадры рассылки уходят первыми, тем же вызовом.
+  const bool ok = write_gather(c.sock, c.outq, std::string_view(data, n));
+  c.outq.clear();
+  c.out_lease.reset();
+  c.out_frames = 0;
+  c.out_due_us = 0;
+  return ok;
+}
+
+bool Server::queue_broadcast(const std::shared_ptr<ClientConn>& cli, const std::string& frame){
+  ClientConn& c = *cli;
+  std::lock_guard<std::mutex> lk(c.wmx);
+  if (!c.alive.load()) return false;
+  if (c.shm){
+    // Вызов идёт под clients_mx_: ждать, пока отставший бот освободит кольцо,
+    // значило бы задержать рассылку всем. Такой бот отключается.
+    if (c.shm->push(frame.data(), frame.size(), 0)) return true;
+    ctr_.shm_lagging.add(1);
+    return false;
+  }
+  if (!cfg_.batch_us) return write_to(c, frame.data(), frame.size());
+
+  const uint64_t now = mono_us();
+  const uint64_t gap = std::min<uint64_t>(c.last_tx_us ? now - c.last_tx_us : 1000000, 1000000);
+  c.last_tx_us = now;
+  c.gap_us = c.gap_us - c.gap_us / 4 + gap / 4;
+  // Склеиваем, только если за окно ожидается ещё хотя бы один кадр:
+  // на редких сообщениях подключение пишет сразу, без добавленной задержки.
+  if (c.outq.empty() && c.gap_us * 2 > cfg_.batch_us) return write_exact(c.sock, frame.data(), frame.size());
+
+  MemLease add;
+  if (!acquire_mem(c, MemBudget::kTx, frame.size(), add, false)){
+    // Копить не на что: очередь и кадр уходят сразу.
+    return write_to(c, frame.data(), frame.size());
+  }
+  c.out_lease.absorb(std::move(add));
+  c.outq += frame;
+  ++c.out_frames;
+  if (c.outq.size() >= (cfg_.batch_kb << 10)) return flush_out(c);
+  if (!c.out_due_us){
+    c.out_due_us = now + cfg_.batch_us;
     {
-      std::lock_guard<std::mutex> lk(clients_mx_);
-      clients_.push_back(cli);
+      std::lock_guard<std::mutex> fl(flush_mx_);
+      flush_q_.emplace_back(c.out_due_us, cli);
     }
-    std::thread(client_thread, this, cli).detach();
+    flush_cv_.notify_one();
+  }
+  return true;
+}
+
+bool Server::flush_out(ClientConn& c){
+  if (c.outq.empty()) return true;
+  // Закрытому подключению (done: сбрасывает alive под тем же wmx) не пишем:
+  // очередь просто освобождается вместе с её долей бюджета.
+  const bool ok = c.alive.load() && write_exact(c.sock, c.outq.data(), c.outq.size());
+  if (ok){
+    ctr_.tx_batches.add(1);
+    ctr_.tx_batched_frames.add(c.out_frames);
+  }
+  c.outq.clear();
+  c.out_lease.reset();
+  c.out_frames = 0;
+  c.out_due_us = 0;
+  return ok;
+}
+
+void Server::flush_loop(){
+  std::unique_lock<std::mutex> lk(flush_mx_);
+  while (!stop_.load()){
+    if (flush_q_.empty()){
+      flush_cv_.wait(lk);
+      continue;
+    }
+    const uint64_t due = flush_q_.front().first;
+    const uint64_t now = mono_us();
+    if (now < due){
+      flush_cv_.wait_for(lk, std::chrono::microseconds(due - now));
+      continue;
+    }
+    std::weak_ptr<ClientConn> w = std::move(flush_q_.front().second);
+    flush_q_.pop_front();
+    lk.unlock();
+    if (auto c = w.lock()){
+      // Если outq уже ушёл вместе с другим кадром, срок другой (или 0) — пропускаем.
+      std::lock_guard<std::mutex> wl(c->wmx);
+      if (c->out_due_us == due && !flush_out(*c)) evict(*c, ctr_.evicted_send_failed);
+    }
+    lk.lock();
   }
 }
 
-bool Server::send_history(socket_t s){
-  auto snapshot = storage_.last(cfg_.history_on_join);
-  for (const auto& m : snapshot){
-    std::string p = make_broadcast(m.ts_ms, m.user, m.text);
-    if (!send_frame(s, MSG_BROADCAST, p)) return false;
+bool Server::attach_shm(ClientConn& c){
+  // Кольцо должно вмещать самый большой кадр (MSG до 1 МБ + заголовок).
+  c.shm = ShmRing::create(std::max<std::size_t>(cfg_.shm_ring_kb << 10, 2u << 20));
+  if (!c.shm) return true;   // платформа без memfd/eventfd: клиент остаётся на сокете
+  std::string info;
+  ShmInfoFrame::append(info, c.shm->capacity());
+  if (!c.shm->offer(c.sock, info)){
+    c.shm.reset();
+    return false;
+  }
+  ctr_.shm_clients.add(1);
+  return true;
+}
+
+bool Server::acquire_mem(ClientConn& c, MemBudget::Kind kind, uint64_t n, MemLease& lease, bool wait){
+  const uint64_t conn_cap = static_cast<uint64_t>(cfg_.conn_mem_kb) << 10;
+  if (conn_cap && c.mem.load() + n > conn_cap){
+    ctr_.mem_conn_rejects.add(1);
+    return false;
+  }
+  const uint64_t deadline = now_ms() + cfg_.mem_wait_ms;
+  while (!mem_.try_charge(kind, n)){
+    if (!wait || stop_.load() || now_ms() >= deadline || !c.alive.load()){
+      ctr_.mem_global_rejects.add(1);
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
   }
+  c.mem += n;
+  uint64_t peak = c.mem_peak.load();
+  while (c.mem.load() > peak && !c.mem_peak.compare_exchange_weak(peak, c.mem.load())) {}
+  lease = MemLease(&mem_, kind, &c.mem, n);
   return true;
 }
 
+bool Server::reserve_history(ClientConn& c, std::size_t count, MemLease& lease){
+  // Резерв берётся до чтения истории, по среднему размеру сообщения в кольце.
+  // Не больше половины лимита подключения: остальное — под кадры, которые
+  // send_messages занимает по мере записи.
+  const uint64_t conn_cap = static_cast<uint64_t>(cfg_.conn_mem_kb) << 10;
+  uint64_t n = static_cast<uint64_t>(count) * storage_.avg_message_bytes();
+  if (conn_cap) n = std::min(n, conn_cap / 2);
+  return acquire_mem(c, MemBudget::kTx, n, lease);
+}
+
+bool Server::send_messages(ClientConn& c, const std::vector<Message>& msgs, const std::string& tail){
+  static constexpr std::size_t kChunk = 64 * 1024;
+  std::string out;
+  auto flush = [&]{
+    if (out.empty()) return true;
+    MemLease lease;
+    if (!acquire_mem(c, MemBudget::kTx, out.size(), lease)) return false;
+    std::lock_guard<std::mutex> lk(c.wmx);
+    const bool ok = write_to(c, out.data(), out.size());
+    out.clear();
+    return ok;
+  };
+  for (const auto& m : msgs){
+    // Не кодируется (поле длиннее префикса) — такое сообщение не рассылалось и при записи.
+    if (!BroadcastFrame::append(out, m.ts_ms, users_.name(m.user_id), m.text, m.seq)) continue;
+    if (out.size() >= kChunk && !flush()) return false;
+  }
+  if (!tail.empty()) out += tail;
+  return flush();
+}
+
+bool Server::send_history(ClientConn& c, const uint64_t* resume_seq){
+  MemLease hold;
+  if (!reserve_history(c, resume_seq ? kResumeMax : cfg_.history_on_join, hold))
+    return send_to(c, ERR, "Server busy: memory budget");
+  std::vector<Message> snapshot;
+  if (resume_seq && storage_.since(*resume_seq, kResumeMax, snapshot)){
+    ctr_.resume_ok.add(1);
+  } else {
+    if (resume_seq) ctr_.resume_miss.add(1);
+    snapshot = storage_.last(cfg_.history_on_join);
+  }
+  return send_messages(c, snapshot, "");
+}
+
+bool Server::send_history_page(ClientConn& c, const std::string& req){
+  HistoryFrame::View v;
+  if (!HistoryFrame::decode(req, v)) return send_to(c, ERR, "Bad HISTORY");
+  auto [before, limit] = v;
+  if (!before) before = UINT64_MAX;
+  if (!limit) limit = 50;
+
+  limit = std::min<std::size_t>(limit, 500);
+  MemLease hold;
+  if (!reserve_history(c, limit, hold)) return send_to(c, ERR, "Server busy: memory budget");
+  auto page = storage_.history(before, limit);
+  std::string tail;
+  HistoryEndFrame::append(tail, static_cast<uint32_t>(page.size()), page.empty() ? 0 : page.front().offset);
+  return send_messages(c, page, tail);
+}
+
+bool Server::send_gap(ClientConn& c, const std::string& req){
+  GapFetchFrame::View v;
+  if (!GapFetchFrame::decode(req, v)) return send_to(c, ERR, "Bad GAP_FETCH");
+  const uint64_t after = std::get<0>(v);
+  const std::size_t count = std::min<std::size_t>(std::get<1>(v), kResumeMax);
+  MemLease hold;
+  if (!reserve_history(c, count, hold)) return send_to(c, ERR, "Server busy: memory budget");
+  std::vector<Message> msgs;
+  if (!count || !storage_.since(after, count, msgs, after + count, kResumeMax)){
+    ctr_.mcast_gap_misses.add(1);
+    return send_to(c, ERR, "Gap not available");
+  }
+  ctr_.mcast_gap_fetches.add(1);
+  return send_messages(c, msgs, "");
+}
+
+void Server::evict(ClientConn& c, const Stats::Counter& reason){
+  if (!c.alive.exchange(false)) return;
+  shutdown(c.sock, SHUT_RDWR);
+  reason.add(1);
+}
+
+void Server::arm_hello_deadline(const std::shared_ptr<ClientConn>& cli){
+  if (!cfg_.hello_timeout_sec) return;
+  std::weak_ptr<ClientConn> w = cli;
+  cli->timer = timers_.schedule(static_cast<uint32_t>(cfg_.hello_timeout_sec * 1000), [this, w]{
+    auto c = w.lock();
+    if (c && !c->greeted.load()) evict(*c, ctr_.evicted_hello_timeout);
+  });
+}
+
+void Server::arm_heartbeat(const std::shared_ptr<ClientConn>& cli){
+  const std::size_t period_sec = cfg_.ping_sec ? cfg_.ping_sec : cfg_.idle_timeout_sec / 2;
+  if (!period_sec || !cli->alive.load()) return;
+  std::weak_ptr<ClientConn> w = cli;
+  cli->timer = timers_.schedule(static_cast<uint32_t>(period_sec * 1000), [this, w]{
+    auto c = w.lock();
+    if (!c || !c->alive.load()) return;
+    const uint64_t idle = now_ms() - c->last_rx_ms.load();
+    if (cfg_.idle_timeout_sec && idle >= cfg_.idle_timeout_sec * 1000){
+      evict(*c, ctr_.evicted_idle);
+      return;
+    }
+    if (cfg_.ping_sec && !c->link && idle >= cfg_.ping_sec * 1000){
+      std::unique_lock<std::mutex> lk(c->wmx, std::try_to_lock);
+      if (!lk.owns_lock()) {}
+      else if (c->shm) c->shm->push_frame(PING, "", 0);   // кольцо занято — потребитель и так не простаивает
+      else if (!c->nowait.send(c->sock, PING, "")) evict(*c, ctr_.evicted_ping_failed);
+    }
+    arm_heartbeat(c);
+  });
+}
+
 void Server::client_thread(Server* self, std::shared_ptr<ClientConn> cli){
-  uint8_t hdr[5];
-  if (!read_exact(cli->sock, hdr, 5)) goto done;
+  uint8_t hdr[wire::kHeaderSize];
+  HelloInfo hello;
+  self->arm_hello_deadline(cli);
+  if (!read_exact(cli->sock, hdr, sizeof(hdr))) goto done;
+  if (hdr[0] == PEER_HELLO || hdr[0] == REPL_SUBSCRIBE){
+    cli->greeted = true;
+    cli->link = true;
+    self->timers_.cancel(cli->timer.load());
+    // Пир и реплика шлют PING сами; молчащий канал закрывается по idle_timeout.
+    cli->last_rx_ms = now_ms();
+    self->arm_heartbeat(cli);
+    // Канал узла или реплики живёт долго и через admit не проходит — место в очереди входов
+    // освобождаем сразу, иначе каждая такая связь навсегда уменьшает join_queue.
+    if (cli->join_pending){ self->join_.leave(); cli->join_pending = false; }
+  }
+  if (hdr[0] == PEER_HELLO){
+    uint32_t len = wire::parse_header(hdr).len;
+    if (len==0 || len>1024){ send_error(cli->sock, "Bad PEER_HELLO"); goto done; }
+    std::string hello(len, '\0');
+    if (read_exact(cli->sock, hello.data(), len)) self->federation_.serve_link(cli->sock, hello, &cli->last_rx_ms);
+    goto done;
+  }
+  if (hdr[0] == REPL_SUBSCRIBE){
+    uint32_t len = wire::parse_header(hdr).len;
+    if (len==0 || len>1024){ send_error(cli->sock, "Bad REPL_SUBSCRIBE"); goto done; }
+    std::string sub(len, '\0');
+    if (read_exact(cli->sock, sub.data(), len)) self->replication_.serve_follower(cli->sock, sub, self->stop_, &cli->last_rx_ms);
+    goto done;
+  }
   if (hdr[0] != HELLO){ send_error(cli->sock, "Expected HELLO"); goto done; }
   {
-    uint32_t len = from_be32(*(uint32_t*)(hdr+1));
+    uint32_t len = wire::parse_header(hdr).len;
     if (len==0 || len>1024){ send_error(cli->sock, "Bad HELLO"); goto done; }
-    std::string username(len, '\0');
-    if (!read_exact(cli->sock, username.data(), len)) goto done;
+    std::string hello_payload(len, '\0');
+    if (!read_exact(cli->sock, hello_payload.data(), len)) goto done;
+    if (!parse_hello(hello_payload, hello)){ send_error(cli->sock, "Bad HELLO"); goto done; }
+    if (self->capture_.enabled()){
+      cli->capture_id = self->capture_.next_conn();
+      self->capture_.record(cli->capture_id, HELLO, hello_payload);
+    }
+    std::string& username = hello.username;
     username.erase(std::remove_if(username.begin(), username.end(),
                    [](unsigned char c){ return c=='\r'||c=='\n'; }), username.end());
     if (username.empty()){ send_error(cli->sock, "Empty username"); goto done; }
     cli->username = username;
+    if (self->replication_.following()){ send_error(cli->sock, "Read-only follower"); goto done; }
 
-    {
-      bool need_write = false;
-      if (self->users_.insert(cli->username).second) need_write = true;
-      if (need_write && self->users_log_.is_open()){
-        self->users_log_ << cli->username << "\n";
-        self->users_log_.flush();
+    // Допуск по корзине токенов: дальше идут запись в users.log, регистрация и история —
+    // при лавине переподключений они выполняются с темпом join_rate, а не все сразу.
+    if (cli->join_pending){
+      cli->join_pending = false;
+      const uint64_t t0 = now_ms();
+      if (!self->join_.admit(self->cfg_.join_wait_ms, self->stop_)){
+        self->ctr_.join_busy_timeout.add(1);
+        send_frame(cli->sock, BUSY, BusyFrame::encode(self->join_.retry_after_ms(), "Server busy"));
+        goto done;
       }
+      self->ctr_.join_admitted.add(1);
+      self->ctr_.join_wait_ms_total.add(static_cast<int64_t>(now_ms() - t0));
     }
+
+    cli->user_id = self->users_.intern(cli->username);
+    cli->mcast = hello.mcast && self->mcast_.enabled();
+    if (hello.shm && cli->local && self->cfg_.shm_ring_kb && !self->attach_shm(*cli)) goto done;
+    cli->greeted = true;
+    cli->last_rx_ms = now_ms();
+    self->timers_.cancel(cli->timer.load());
+    self->arm_heartbeat(cli);
+
+    std::lock_guard<std::mutex> lk(self->clients_mx_);
+    self->clients_.push_back(cli);
+    self->sessions_.emplace(cli->user_id, cli);
   }
-  if (!send_ok(cli->sock)) goto done;
+  if (!self->send_to(*cli, OK, "")) goto done;
+  if (cli->mcast && !self->send_to(*cli, MCAST_INFO, McastInfoFrame::encode(self->mcast_.group(), self->mcast_.port()))) goto done;
 
-  if (!self->send_history(cli->sock)) goto done;
+  if (!self->send_history(*cli, hello.resume ? &hello.resume_seq : nullptr)) goto done;
 
   while(!self->stop_.load()){
-    if (!read_exact(cli->sock, hdr, 5)) break;
-    uint8_t type = hdr[0];
-    uint32_t plen = from_be32(*(uint32_t*)(hdr+1));
-    if (plen > (1u<<20)){ send_error(cli->sock, "Payload too big"); break; }
+    if (!read_exact(cli->sock, hdr, sizeof(hdr))) break;
+    cli->last_rx_ms = now_ms();
+    const auto [type, plen] = wire::parse_header(hdr);
+    if (plen > (1u<<20)){ self->send_to(*cli, ERR, "Payload too big"); break; }
+    MemLease rx;
+    if (!self->acquire_mem(*cli, MemBudget::kRx, plen, rx)){
+      self->send_to(*cli, ERR, "Memory budget exceeded");
+      self->evict(*cli, self->ctr_.evicted_mem_budget);
+      break;
+    }
     std::string payload(plen, '\0');
     if (plen && !read_exact(cli->sock, payload.data(), plen)) break;
+    if (cli->capture_id) self->capture_.record(cli->capture_id, type, payload);
 
     if (type == MSG){
       self->on_message(cli, payload);
+    } else if (type == PING){
+      if (!self->send_to(*cli, PONG, "")) break;
+    } else if (type == DM){
+      if (!self->on_direct(cli, payload)) break;
+    } else if (type == HISTORY){
+      if (!self->send_history_page(*cli, payload)) break;
+    } else if (type == GAP_FETCH){
+      if (!self->send_gap(*cli, payload)) break;
+    } else if (type == ATTACH_BEGIN || type == ATTACH_CHUNK){
+      if (!self->on_upload(*cli, type, payload)) break;
+    } else if (type == MSG_ATTACH){
+      if (!self->on_attach(cli, payload)) break;
+    } else if (type == BLOB_GET){
+      if (!self->send_blob(*cli, payload)) break;
     }
   }
 
 done:
-  cli->alive = false;
-  CLOSESOCK(cli->sock);
+  if (cli->join_pending) self->join_.leave();
+  if (cli->capture_id) self->capture_.record(cli->capture_id, kCaptureClose, "");
+  {
+    // Остальные писатели проверяют alive под wmx; после shutdown их send сразу
+    // завершается ошибкой, а сам fd закроет ~ClientConn.
+    std::lock_guard<std::mutex> lk(cli->wmx);
+    cli->alive = false;
+    shutdown(cli->sock, SHUT_RDWR);
+    self->flush_out(*cli);   // только освобождает outq: alive уже false
+  }
+  self->timers_.cancel(cli->timer.load());
   {
     std::lock_guard<std::mutex> lk(self->clients_mx_);
     self->clients_.erase(std::remove_if(self->clients_.begin(), self->clients_.end(),
       [&](const std::shared_ptr<ClientConn>& c){ return c.get()==cli.get(); }), self->clients_.end());
+    auto range = self->sessions_.equal_range(cli->user_id);
+    for (auto it = range.first; it != range.second; ++it){
+      if (it->second.get() == cli.get()){ self->sessions_.erase(it); break; }
+    }
   }
 }
 
 void Server::on_message(const std::shared_ptr<ClientConn>& cli, const std::string& text){
   Message m;
   m.ts_ms = now_ms();
-  m.user  = cli->username;
+  m.user_id = cli->user_id;
   m.text  = text;
 
-  std::string sig = std::to_string(m.ts_ms) + "|" + m.user + "|" + m.text + "|" + cfg_.secret;
-  m.hash_hex = hex64(fnv1a64(sig));
+  TraceMessage trace(&tracer_, "message");
+  {
+    TraceSpan span(&tracer_, "federation.publish");
+    federation_.publish(m);
+  }
+  deliver(std::move(m));
+}
+
+bool Server::on_direct(const std::shared_ptr<ClientConn>& cli, const std::string& payload){
+  DmFrame::View v;
+  if (!DmFrame::decode(payload, v) || std::get<0>(v).empty()) return send_to(*cli, ERR, "Bad DM");
+  const std::string to(std::get<0>(v));
+
+  DirectMessage m;
+  m.ts_ms = now_ms();
+  m.from_id = cli->user_id;
+  m.to_id = users_.find(to);
+  m.text = std::string(std::get<1>(v));
+  if (m.to_id == UserRegistry::kNone) return send_to(*cli, ERR, "Unknown user");
+  m.hash = fnv1a64(std::to_string(m.ts_ms) + "|" + cli->username + "|" + to + "|" + m.text + "|" + cfg_.secret);
+
+  // Кодируем до записи: DM, который не уйдёт получателю, незачем хранить.
+  const std::string frame = DirectFrame::encode(m.ts_ms, cli->username, users_.name(m.to_id), m.text);
+  if (frame.empty()) return send_to(*cli, ERR, "Message too long");
+  if (!storage_.append_direct(m)){
+    ctr_.dm_store_failed.add(1);
+    return send_to(*cli, ERR, "DM not stored");
+  }
+  ctr_.dm_total.add(1);
+
+  std::vector<std::shared_ptr<ClientConn>> targets;
+  {
+    std::lock_guard<std::mutex> lk(clients_mx_);
+    auto add = [&](uint32_t id){
+      auto range = sessions_.equal_range(id);
+      for (auto it = range.first; it != range.second; ++it) targets.push_back(it->second);
+    };
+    add(m.to_id);
+    if (m.from_id != m.to_id) add(m.from_id);
+  }
+
+  for (const auto& c : targets){
+    if (!c->alive.load()) continue;
+    if (!send_to(*c, MSG_DIRECT, frame) && c != cli) evict(*c, ctr_.evicted_send_failed);
+  }
+  return cli->alive.load();
+}
+
+bool Server::on_upload(ClientConn& c, uint8_t type, const std::string& payload){
+  if (!blobs_.enabled()) return send_to(c, ERR, "Attachments disabled");
+  std::string_view id, data;
+  uint64_t size = 0, offset = 0;
+  if (type == ATTACH_BEGIN){
+    AttachBeginFrame::View v;
+    if (!AttachBeginFrame::decode(payload, v)) return send_to(c, ERR, "Bad ATTACH_BEGIN");
+    std::tie(id, size) = v;
+  } else {
+    AttachChunkFrame::View v;
+    if (!AttachChunkFrame::decode(payload, v)) return send_to(c, ERR, "Bad ATTACH_CHUNK");
+    std::tie(id, size, offset, data) = v;
+  }
+  const std::string key(id);
+  if (!BlobStore::valid_id(key) || !size) return send_to(c, ERR, "Bad attachment id");
+  if (size > blobs_.max_blob()) return send_to(c, ERR, "Attachment too large");
+  if (type == ATTACH_BEGIN){
+    uint64_t have = 0;
+    if (blobs_.begin(key, size, have) == BlobStore::Put::kQuota){
+      ctr_.attach_quota_rejects.add(1);
+      return send_to(c, ERR, "Attachment storage full");
+    }
+    return send_to(c, ATTACH_ACK, AttachAckFrame::encode(key, have));
+  }
+
+  switch (blobs_.put(key, size, offset, data)){
+    case BlobStore::Put::kPartial:
+      ctr_.attach_bytes_in.add(static_cast<int64_t>(data.size()));
+      return true;
+    case BlobStore::Put::kComplete:
+      ctr_.attach_bytes_in.add(static_cast<int64_t>(data.size()));
+      return send_to(c, ATTACH_ACK, AttachAckFrame::encode(key, size));
+    case BlobStore::Put::kBadOffset:
+      // Клиент разошёлся с сервером (повтор, обрыв): сообщаем, откуда продолжать.
+      return send_to(c, ATTACH_ACK, AttachAckFrame::encode(key, blobs_.have(key, size)));
+    case BlobStore::Put::kTooLarge:
+      return send_to(c, ERR, "Attachment too large");
+    case BlobStore::Put::kQuota:
+      ctr_.attach_quota_rejects.add(1);
+      return send_to(c, ERR, "Attachment storage full");
+    case BlobStore::Put::kMismatch:
+      ctr_.attach_mismatch.add(1);
+      return send_to(c, ERR, "Attachment hash mismatch");
+    case BlobStore::Put::kIoError:
+      break;
+  }
+  return send_to(c, ERR, "Attachment not stored");
+}
+
+bool Server::on_attach(const std::shared_ptr<ClientConn>& cli, const std::string& payload){
+  MsgAttachFrame::View v;
+  if (!blobs_.enabled() || !MsgAttachFrame::decode(payload, v)) return send_to(*cli, ERR, "Bad MSG_ATTACH");
+  const std::string id(std::get<0>(v));
+  uint64_t size = 0;
+  if (!BlobStore::valid_id(id) || !blobs_.stat(id, size)) return send_to(*cli, ERR, "Unknown attachment");
+
+  std::string name(std::get<1>(v));
+  name.erase(std::remove_if(name.begin(), name.end(),
+             [](unsigned char c){ return c=='\r'||c=='\n'; }), name.end());
+  if (name.empty()) name = id.substr(0, 12);
+  ctr_.attach_messages.add(1);
+  on_message(cli, attach_ref(id, size, name, std::get<2>(v)));
+  return cli->alive.load();
+}
+
+bool Server::send_blob(ClientConn& c, const std::string& payload){
+  static constexpr uint32_t kBlobChunk = 256 * 1024;
+  BlobGetFrame::View v;
+  if (!BlobGetFrame::decode(payload, v)) return send_to(c, ERR, "Bad BLOB_GET");
+  const std::string id(std::get<0>(v));
+  uint64_t size = 0, off = std::get<1>(v);
+  if (!blobs_.enabled() || !BlobStore::valid_id(id) || !blobs_.stat(id, size)) return send_to(c, ERR, "Unknown attachment");
+  if (off > size) return send_to(c, ERR, "Bad BLOB_GET offset");
+
+  // Файл идёт кусками по kBlobChunk, wmx отпускается между ними, чтобы рассылка
+  // чата этому клиенту не ждала конца большого файла. Последний кусок
+  // (offset + len == size) может быть пустым.
+  const std::string path = blobs_.path(id);
+  do {
+    const uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(kBlobChunk, size - off));
+    std::lock_guard<std::mutex> lk(c.wmx);
+    if (c.shm){
+      std::string chunk(n, '\0');
+      std::ifstream in(path, std::ios::binary);
+      if (!in.seekg(static_cast<std::streamoff>(off)) || !in.read(chunk.data(), n)) return false;
+      if (!c.shm->push_frame(BLOB_DATA, BlobDataHead::encode(id, off) + chunk, static_cast<int>(cfg_.mem_wait_ms))) return false;
+    } else if (!flush_out(c) || !send_file_frame(c.sock, BLOB_DATA, BlobDataHead::encode(id, off), path, off, n)){
+      return false;
+    }
+    ctr_.attach_bytes_out.add(static_cast<int64_t>(n));
+    off += n;
+  } while (off < size && c.alive.load() && !stop_.load());
+  return true;
+}
 
-  storage_.append(m);
+void Server::deliver(Message m){
+  const std::string& user = users_.name(m.user_id);
+  TraceSpan span(&tracer_, "storage.append");
+  storage_.append(m, [this, user](Message& x){
+    x.hash = fnv1a64(std::to_string(x.ts_ms) + "|" + user + "|" + x.text + "|" + cfg_.secret);
+  });
+}
 
-  std::string payload = make_broadcast(m.ts_ms, m.user, m.text);
-  std::lock_guard<std::mutex> lk(clients_mx_);
+void Server::broadcast(const Message& m, uint64_t trace){
+  // Сюда сообщения приходят из Storage после записи, по одному и по порядку seq:
+  // кадры уходят клиентам и в группу в том же порядке, а пропуск, замеченный
+  // клиентом, уже есть в since().
+  ctr_.messages_total.add(1);
+  const std::string& user = users_.name(m.user_id);
+  std::string frame;
+  if (!BroadcastFrame::append(frame, m.ts_ms, user, m.text, m.seq)){
+    std::cerr<<"Message "<<m.seq<<" does not fit MSG_BROADCAST, not sent\n";
+    return;
+  }
+  if (mcast_.enabled()){
+    // Одна датаграмма на всех multicast-клиентов; seq учитывается и для слишком
+    // больших сообщений, чтобы MCAST_TAIL показал пропуск и клиент добрал его по TCP.
+    TraceSpan span(&tracer_, "mcast.send", trace);
+    const bool sent = mcast_.send(frame);
+    mcast_seq_ = m.seq;
+    if (!sent){
+      // Не влезло в датаграмму: MCAST_TAIL сразу, а не через секунду — клиент
+      // увидит пропуск и заберёт сообщение по TCP.
+      std::string tail;
+      McastTailFrame::append(tail, m.seq);
+      mcast_.send(tail);
+    }
+  }
+  std::unique_lock<std::mutex> lk(clients_mx_, std::defer_lock);
+  {
+    TraceSpan span(&tracer_, "clients_mx.wait", trace);
+    lk.lock();
+  }
+  TraceSpan span(&tracer_, "broadcast", trace);
+  std::vector<std::shared_ptr<ClientConn>> failed;
   for (auto it = clients_.begin(); it != clients_.end(); ){
     auto c = *it;
     if (!c->alive.load()){
       it = clients_.erase(it);
       continue;
     }
-    if (!send_frame(c->sock, MSG_BROADCAST, payload)){
-      c->alive = false;
-      CLOSESOCK(c->sock);
+    if (c->mcast){
+      ++it;
+      continue;
+    }
+    bool ok;
+    {
+      TraceSpan send_span(&tracer_, "send_frame", trace);
+      ok = queue_broadcast(c, frame);
+    }
+    if (!ok){
+      failed.push_back(std::move(c));
       it = clients_.erase(it);
     } else {
       ++it;
     }
   }
+  lk.unlock();
+  for (const auto& c : failed) evict(*c, ctr_.evicted_send_failed);
 }
 
 }
@@ -3,23 +3,67 @@
 
 #include "storage/storage.hpp"
 #include "config/config.hpp"
+#include "net/federation.hpp"
+#include "net/protocol.hpp"
+#include "net/replication.hpp"
+#include "net/capture.hpp"
+#include "net/multicast.hpp"
+#include "net/shm_ring.hpp"
+#include "storage/compactor.hpp"
+#include "storage/blobs.hpp"
+#include "stats/stats.hpp"
+#include "stats/trace.hpp"
+#include "util/timer_wheel.hpp"
+#include "util/mem_budget.hpp"
+#include "util/work_pool.hpp"
+#include "util/join_gate.hpp"
 #include "util/utils.hpp"
 
-#include <unordered_set>
-#include <fstream>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <string>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
 
 namespace lanchat {
 
 struct ClientConn {
-  socket_t sock;
+  // Сокет закрывается только здесь, когда отпущена последняя ссылка: таймер или
+  // сброс outq, державший shared_ptr, не запишет в fd, уже отданный новому accept.
+  ~ClientConn(){
+    nowait.reset();
+    if (sock != INVALID_SOCK) CLOSESOCK(sock);
+  }
+
+  socket_t sock = INVALID_SOCK;
   std::string username;
+  uint32_t user_id = UserRegistry::kNone;
   std::atomic<bool> alive{true};
+  std::atomic<bool> greeted{false};
+  std::atomic<uint64_t> last_rx_ms{0};
+  std::atomic<TimerWheel::TimerId> timer{0};
+  std::atomic<uint64_t> mem{0};        // байты буферов, взятых из бюджета этим подключением
+  std::atomic<uint64_t> mem_peak{0};
+  uint32_t capture_id = 0;
+  bool mcast = false;                  // MSG_BROADCAST приходят из multicast-группы, по TCP — только догрузка пропусков
+  bool local = false;                  // подключение через Unix-сокет
+  bool join_pending = false;           // занято место в очереди JoinGate
+  bool link = false;                   // канал узла или реплики: PING не шлём, только idle-вытеснение
+  std::unique_ptr<ShmRing> shm;        // исходящие кадры идут в общую память, а не в сокет
+  std::mutex wmx;
+  NowaitSender nowait;                 // PING из таймера (под wmx)
+  // Склейка MSG_BROADCAST (под wmx): при плотном потоке кадры копятся в outq
+  // и уходят одной записью по истечении окна или при наборе batch_kb.
+  std::string outq;
+  uint32_t out_frames = 0;
+  uint64_t out_due_us = 0;             // срок сброса outq (0 — очередь пуста)
+  MemLease out_lease;                  // байты outq в бюджете kTx
+  uint64_t last_tx_us = 0;
+  uint64_t gap_us = 1000000;           // сглаженный интервал между кадрами рассылки
 };
 
 class Server {
@@ -29,25 +73,87 @@ public:
 
   bool start();
   void stop();
+  // force — повысить, даже если у лидера есть нереплицируемые DM и вложения.
+  bool promote(bool force = false);
 
 private:
-  void accept_loop();
+  bool port_is_free(const sockaddr_in& addr);
+  socket_t open_listener(const sockaddr_in& addr, bool reuse_port);
+  socket_t open_unix_listener(const std::string& path);
+  void accept_loop(socket_t ls, Stats::Counter accepted, bool local);
   static void client_thread(Server* self, std::shared_ptr<ClientConn> cli);
   void on_message(const std::shared_ptr<ClientConn>& cli, const std::string& text);
-  bool send_history(socket_t s);
+  bool on_direct(const std::shared_ptr<ClientConn>& cli, const std::string& payload);
+  bool on_upload(ClientConn& c, uint8_t type, const std::string& payload);
+  bool on_attach(const std::shared_ptr<ClientConn>& cli, const std::string& payload);
+  bool send_blob(ClientConn& c, const std::string& payload);
+  void deliver(Message m);
+  void broadcast(const Message& m, uint64_t trace);
+  void housekeeping_loop();
+  void write_snapshot();
+  bool send_to(ClientConn& c, uint8_t type, const std::string& payload);
+  bool write_to(ClientConn& c, const char* data, std::size_t n);
+  bool queue_broadcast(const std::shared_ptr<ClientConn>& cli, const std::string& frame);
+  bool flush_out(ClientConn& c);
+  void flush_loop();
+  bool attach_shm(ClientConn& c);
+  bool acquire_mem(ClientConn& c, MemBudget::Kind kind, uint64_t n, MemLease& lease, bool wait = true);
+  bool reserve_history(ClientConn& c, std::size_t count, MemLease& lease);
+  bool send_messages(ClientConn& c, const std::vector<Message>& msgs, const std::string& tail);
+  bool send_history(ClientConn& c, const uint64_t* resume_seq);
+  bool send_history_page(ClientConn& c, const std::string& req);
+  bool send_gap(ClientConn& c, const std::string& req);
+  void evict(ClientConn& c, const Stats::Counter& reason);
+  void arm_hello_deadline(const std::shared_ptr<ClientConn>& cli);
+  void arm_heartbeat(const std::shared_ptr<ClientConn>& cli);
 
 private:
   Config cfg_;
-  socket_t srv_{INVALID_SOCK};
+  std::vector<socket_t> listeners_;
   std::atomic<bool> stop_{false};
 
   std::mutex clients_mx_;
   std::vector<std::shared_ptr<ClientConn>> clients_;
+  std::unordered_multimap<uint32_t, std::shared_ptr<ClientConn>> sessions_;  // user_id -> сессии
 
+  UserRegistry users_;
+  WorkPool pool_;
   Storage storage_;
 
-  std::unordered_set<std::string> users_;
-  std::ofstream users_log_;
+  Stats stats_;
+  // Счётчики горячих путей регистрируются один раз: дальше без поиска по имени.
+  struct Counters {
+    explicit Counters(Stats& s);
+    Stats::Counter messages_total;
+    Stats::Counter join_busy_queue, join_busy_timeout, join_admitted, join_wait_ms_total;
+    Stats::Counter shm_clients, shm_lagging;
+    Stats::Counter tx_batches, tx_batched_frames;
+    Stats::Counter mem_conn_rejects, mem_global_rejects;
+    Stats::Counter resume_ok, resume_miss;
+    Stats::Counter mcast_gap_fetches, mcast_gap_misses;
+    Stats::Counter dm_total, dm_store_failed;
+    Stats::Counter attach_messages, attach_bytes_in, attach_bytes_out, attach_quota_rejects, attach_mismatch;
+    Stats::Counter evicted_send_failed, evicted_hello_timeout, evicted_idle, evicted_ping_failed, evicted_mem_budget;
+  } ctr_{stats_};
+  Tracer tracer_;
+  MemBudget mem_;
+  JoinGate join_;
+  Capture capture_;
+  BlobStore blobs_;
+  Multicast mcast_;
+  std::atomic<uint64_t> mcast_seq_{0};   // последний seq, ушедший в группу (или пропущенный как слишком большой)
+  TimerWheel timers_{/*tick_ms*/100};
+  Federation federation_;
+  Replication replication_;
+  Compactor compactor_;
+  std::mutex snapshot_mx_;
+  std::thread housekeeping_;
+  // Отложенные сбросы outq; окно у всех одно, поэтому очередь упорядочена по сроку.
+  std::mutex flush_mx_;
+  std::condition_variable flush_cv_;
+  std::deque<std::pair<uint64_t, std::weak_ptr<ClientConn>>> flush_q_;
+  std::thread flusher_;
+  std::atomic<uint64_t> snapshot_offset_{UINT64_MAX};
 };
 
 }
@@ -0,0 +1,120 @@
+#include "net/shm_ring.hpp"
+#include "net/wire.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#if defined(__linux__)
+  #include <sys/eventfd.h>
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+namespace lanchat {
+
+#if defined(__linux__)
+
+std::unique_ptr<ShmRing> ShmRing::create(std::size_t capacity){
+  std::unique_ptr<ShmRing> r(new ShmRing());
+  r->capacity_ = capacity;
+  r->mem_fd_ = memfd_create("lanchat-ring", MFD_CLOEXEC);
+  r->event_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (r->mem_fd_ < 0 || r->event_fd_ < 0) return nullptr;
+  const std::size_t total = kShmHeaderSize + capacity;
+  if (ftruncate(r->mem_fd_, static_cast<off_t>(total)) != 0) return nullptr;
+  void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, r->mem_fd_, 0);
+  if (p == MAP_FAILED) return nullptr;
+  r->hdr_ = new (p) ShmRingHeader();
+  r->hdr_->magic = kShmMagic;
+  r->hdr_->version = kShmVersion;
+  r->hdr_->capacity = capacity;
+  r->data_ = static_cast<char*>(p) + kShmHeaderSize;
+  return r;
+}
+
+ShmRing::~ShmRing(){
+  if (hdr_) munmap(hdr_, kShmHeaderSize + capacity_);
+  if (mem_fd_ >= 0) ::close(mem_fd_);
+  if (event_fd_ >= 0) ::close(event_fd_);
+}
+
+void ShmRing::wake(){
+  const uint64_t one = 1;
+  if (write(event_fd_, &one, sizeof(one)) < 0) {}
+}
+
+bool ShmRing::offer(int sock, const std::string& bytes) const {
+  const int fds[2] = { mem_fd_, event_fd_ };
+  alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(fds))] = {};
+  iovec iov{ const_cast<char*>(bytes.data()), bytes.size() };
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+  cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_SOCKET;
+  cm->cmsg_type = SCM_RIGHTS;
+  cm->cmsg_len = CMSG_LEN(sizeof(fds));
+  std::memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(bytes.size());
+}
+
+#else
+
+std::unique_ptr<ShmRing> ShmRing::create(std::size_t){ return nullptr; }
+ShmRing::~ShmRing() = default;
+void ShmRing::wake(){}
+bool ShmRing::offer(int, const std::string&) const { return false; }
+
+#endif
+
+void ShmRing::copy_in(uint64_t pos, const char* data, std::size_t n){
+  const std::size_t at = static_cast<std::size_t>(pos % capacity_);
+  const std::size_t first = std::min(n, capacity_ - at);
+  std::memcpy(data_ + at, data, first);
+  if (first < n) std::memcpy(data_, data + first, n - first);
+}
+
+bool ShmRing::reserve(std::size_t n, int timeout_ms, uint64_t& head){
+  if (n > capacity_) return false;
+  head = hdr_->head.load(std::memory_order_relaxed);
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (capacity_ - (head - hdr_->tail.load(std::memory_order_acquire)) < n){
+    if (std::chrono::steady_clock::now() >= deadline) return false;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  return true;
+}
+
+void ShmRing::publish(uint64_t head){
+  // seq_cst в паре с waiting: либо потребитель увидит новый head, либо мы увидим waiting.
+  hdr_->head.store(head, std::memory_order_seq_cst);
+  if (hdr_->waiting.load(std::memory_order_seq_cst)) wake();
+}
+
+bool ShmRing::push(const char* data, std::size_t n, int timeout_ms){
+  uint64_t head;
+  if (!reserve(n, timeout_ms, head)) return false;
+  copy_in(head, data, n);
+  publish(head + n);
+  return true;
+}
+
+bool ShmRing::push_frame(uint8_t type, const std::string& payload, int timeout_ms){
+  // Заголовок и payload публикуются вместе: потребитель не увидит кадр наполовину.
+  uint64_t head;
+  if (!reserve(wire::kHeaderSize + payload.size(), timeout_ms, head)) return false;
+  char hdr[wire::kHeaderSize];
+  wire::put_header(hdr, type, static_cast<uint32_t>(payload.size()));
+  copy_in(head, hdr, sizeof(hdr));
+  copy_in(head + sizeof(hdr), payload.data(), payload.size());
+  publish(head + sizeof(hdr) + payload.size());
+  return true;
+}
+
+}
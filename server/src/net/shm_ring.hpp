@@ -0,0 +1,80 @@
+#ifndef LANCHAT_NET_SHM_RING_HPP
+#define LANCHAT_NET_SHM_RING_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <string>
+
+namespace lanchat {
+
+/*
+ * Разметка разделяемой памяти кольца (memfd). Заголовок занимает первые
+ * kShmHeaderSize байт, дальше capacity байт данных. head и tail — сквозные
+ * счётчики байт, позиция в данных = счётчик % capacity; кадр может переходить
+ * через конец области.
+ *
+ * Потребитель (бот):
+ *   1. tail == head: записать waiting = 1, перечитать head; если по-прежнему
+ *      пусто — ждать eventfd (вместе с сокетом, чтобы заметить отключение), затем waiting = 0;
+ *   2. прочитать кадры из [tail, head), записать tail = head.
+ * Сервер после публикации head будит eventfd, только если waiting != 0.
+ */
+static constexpr uint32_t kShmMagic = 0x4C435352;  // "LCSR"
+static constexpr uint32_t kShmVersion = 1;
+static constexpr std::size_t kShmHeaderSize = 4096;
+
+struct ShmRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t capacity;
+  alignas(64) std::atomic<uint64_t> head;     // пишет только сервер
+  alignas(64) std::atomic<uint64_t> tail;     // пишет только потребитель
+  alignas(64) std::atomic<uint32_t> waiting;  // потребитель спит на eventfd
+};
+
+static_assert(sizeof(ShmRingHeader) <= kShmHeaderSize, "shm header must fit its page");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm ring needs address-free atomics");
+
+/**
+ * Кольцо сервер -> клиент в разделяемой памяти (один писатель, один читатель)
+ * для ботов на той же машине: кадры того же протокола копируются один раз
+ * в общую память, пробуждение — через eventfd. memfd и eventfd передаются
+ * клиенту через Unix-сокет (SCM_RIGHTS). Только Linux.
+ */
+class ShmRing {
+public:
+  static std::unique_ptr<ShmRing> create(std::size_t capacity);
+  ~ShmRing();
+  ShmRing(const ShmRing&) = delete;
+  ShmRing& operator=(const ShmRing&) = delete;
+
+  int mem_fd() const { return mem_fd_; }
+  int event_fd() const { return event_fd_; }
+  std::size_t capacity() const { return capacity_; }
+
+  // Кладёт байты целиком; если потребитель отстал, ждёт до timeout_ms (0 — не ждёт) и возвращает false.
+  bool push(const char* data, std::size_t n, int timeout_ms);
+  bool push_frame(uint8_t type, const std::string& payload, int timeout_ms);
+  // Разбудить потребителя безусловно (например, перед закрытием).
+  void wake();
+  // Отправить по Unix-сокету bytes вместе с memfd и eventfd (SCM_RIGHTS).
+  bool offer(int sock, const std::string& bytes) const;
+
+private:
+  ShmRing() = default;
+  bool reserve(std::size_t n, int timeout_ms, uint64_t& head);
+  void copy_in(uint64_t pos, const char* data, std::size_t n);
+  void publish(uint64_t head);
+
+  int mem_fd_ = -1;
+  int event_fd_ = -1;
+  std::size_t capacity_ = 0;
+  ShmRingHeader* hdr_ = nullptr;
+  char* data_ = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef LANCHAT_NET_WIRE_HPP
+#define LANCHAT_NET_WIRE_HPP
+
+#include "util/utils.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace lanchat {
+namespace wire {
+
+// Заголовок кадра: type u8 + len u32 BE.
+static constexpr std::size_t kHeaderSize = 5;
+
+inline uint8_t  bswap(uint8_t v)  { return v; }
+inline uint16_t bswap(uint16_t v) { return to_be16(v); }
+inline uint32_t bswap(uint32_t v) { return to_be32(v); }
+inline uint64_t bswap(uint64_t v) { return to_be64(v); }
+
+template <class T>
+inline T load_be(const char* p){
+  T v; std::memcpy(&v, p, sizeof(T));
+  return bswap(v);
+}
+
+template <class T>
+inline char* store_be(char* p, T v){
+  v = bswap(v);
+  std::memcpy(p, &v, sizeof(T));
+  return p + sizeof(T);
+}
+
+struct Header {
+  uint8_t  type;
+  uint32_t len;
+};
+
+inline Header parse_header(const uint8_t* hdr){
+  return { hdr[0], load_be<uint32_t>(reinterpret_cast<const char*>(hdr + 1)) };
+}
+
+inline char* put_header(char* p, uint8_t type, uint32_t len){
+  *p++ = static_cast<char>(type);
+  return store_be(p, len);
+}
+
+/*
+ * Поля схемы. Каждое поле знает:
+ *   value_type / view_type — что принимает кодер и что отдаёт декодер;
+ *   kMin, kFixed           — минимальный размер и признак фиксированной длины;
+ *   fits(v)                — помещается ли значение в поле (длина под префикс);
+ *   size(v), put(p, v)     — точный размер и запись без проверок (буфер уже выделен);
+ *   get(p, end, v)         — чтение с проверкой границ, строки — string_view в payload.
+ */
+
+template <class T>
+struct Int {
+  using value_type = T;
+  using view_type  = T;
+  static constexpr std::size_t kMin = sizeof(T);
+  static constexpr bool kFixed = true;
+
+  static constexpr bool fits(T) { return true; }
+  static constexpr std::size_t size(T) { return sizeof(T); }
+  static char* put(char* p, T v) { return store_be(p, v); }
+  static bool get(const char*& p, const char* end, T& v){
+    if (static_cast<std::size_t>(end - p) < sizeof(T)) return false;
+    v = load_be<T>(p);
+    p += sizeof(T);
+    return true;
+  }
+};
+
+using U8  = Int<uint8_t>;
+using U16 = Int<uint16_t>;
+using U32 = Int<uint32_t>;
+using U64 = Int<uint64_t>;
+
+// Байты с префиксом длины Len. Значение длиннее максимума Len не режется молча:
+// Frame::fits() отвергает его, и кодер возвращает отказ до записи.
+template <class Len>
+struct Str {
+  using value_type = std::string_view;
+  using view_type  = std::string_view;
+  static constexpr std::size_t kMin = sizeof(Len);
+  static constexpr bool kFixed = false;
+  static constexpr std::size_t kMax = std::numeric_limits<Len>::max();
+
+  static bool fits(std::string_view v) { return v.size() <= kMax; }
+  static std::size_t size(std::string_view v) { return sizeof(Len) + v.size(); }
+  static char* put(char* p, std::string_view v){
+    p = store_be(p, static_cast<Len>(v.size()));
+    if (!v.empty()) std::memcpy(p, v.data(), v.size());
+    return p + v.size();
+  }
+  static bool get(const char*& p, const char* end, std::string_view& v){
+    Len n;
+    if (!Int<Len>::get(p, end, n)) return false;
+    if (static_cast<std::size_t>(end - p) < n) return false;
+    v = std::string_view(p, n);
+    p += n;
+    return true;
+  }
+};
+
+using Str16   = Str<uint16_t>;
+using Bytes32 = Str<uint32_t>;
+
+// Всё до конца payload; допустимо только последним полем.
+struct Rest {
+  using value_type = std::string_view;
+  using view_type  = std::string_view;
+  static constexpr std::size_t kMin = 0;
+  static constexpr bool kFixed = false;
+
+  static bool fits(std::string_view) { return true; }
+  static std::size_t size(std::string_view v) { return v.size(); }
+  static char* put(char* p, std::string_view v){
+    if (!v.empty()) std::memcpy(p, v.data(), v.size());
+    return p + v.size();
+  }
+  static bool get(const char*& p, const char* end, std::string_view& v){
+    v = std::string_view(p, static_cast<std::size_t>(end - p));
+    p = end;
+    return true;
+  }
+};
+
+// Необязательное число в хвосте кадра: 0 не пишется, отсутствие читается как 0.
+template <class T>
+struct Opt {
+  using value_type = T;
+  using view_type  = T;
+  static constexpr std::size_t kMin = 0;
+  static constexpr bool kFixed = false;
+
+  static constexpr bool fits(T) { return true; }
+  static constexpr std::size_t size(T v) { return v ? sizeof(T) : 0; }
+  static char* put(char* p, T v) { return v ? store_be(p, v) : p; }
+  static bool get(const char*& p, const char* end, T& v){
+    if (static_cast<std::size_t>(end - p) < sizeof(T)){ v = 0; return true; }
+    return Int<T>::get(p, end, v);
+  }
+};
+
+namespace detail {
+
+// Rest забирает всё до конца payload, поэтому поле после него не прочитать.
+template <class... F>
+constexpr bool rest_is_last(){
+  constexpr bool is_rest[] = {false, std::is_same_v<F, Rest>...};
+  for (std::size_t i = 1; i < sizeof...(F); ++i)
+    if (is_rest[i]) return false;
+  return true;
+}
+
+}
+
+/**
+ * Схема кадра: тип и список полей. По ней генерируются кодер с точным
+ * предвычисленным размером (одна аллокация, без промежуточных строк)
+ * и декодер, который проверяет границы и возвращает View — кортеж
+ * чисел и string_view, указывающих прямо в исходный payload.
+ * Для кадров из полей фиксированной длины проверка размера одна — kMinSize,
+ * дальше идут прямые загрузки.
+ * Кодеры не бросают: значение, которое не помещается в свой префикс длины
+ * (или payload длиннее u32), даёт false / пустую строку, а out не меняется.
+ */
+template <uint8_t Type, class... F>
+struct Frame {
+  static_assert(detail::rest_is_last<F...>(), "wire::Rest must be the last field of a frame");
+  static constexpr uint8_t kType = Type;
+  static constexpr std::size_t kMinSize = (std::size_t{0} + ... + F::kMin);
+  static constexpr bool kFixed = (true && ... && F::kFixed);
+
+  using View = std::tuple<typename F::view_type...>;
+
+  static std::size_t size(const typename F::value_type&... v){
+    return (std::size_t{0} + ... + F::size(v));
+  }
+
+  static bool fits(const typename F::value_type&... v){
+    return (true && ... && F::fits(v)) && size(v...) <= std::numeric_limits<uint32_t>::max();
+  }
+
+  // Дописывает payload в out; false — значение не помещается в поле, out не тронут.
+  static bool encode_to(std::string& out, const typename F::value_type&... v){
+    if (!fits(v...)) return false;
+    const std::size_t at = out.size();
+    out.resize(at + size(v...));
+    char* p = &out[at];
+    ((p = F::put(p, v)), ...);
+    return true;
+  }
+
+  // Пустая строка при отказе: у кадров с обязательными полями payload не бывает пустым.
+  static std::string encode(const typename F::value_type&... v){
+    std::string out;
+    encode_to(out, v...);
+    return out;
+  }
+
+  // Дописывает в out кадр целиком: заголовок + payload. false — как у encode_to.
+  static bool append(std::string& out, const typename F::value_type&... v){
+    if (!fits(v...)) return false;
+    const std::size_t n = size(v...);
+    const std::size_t at = out.size();
+    out.resize(at + kHeaderSize + n);
+    char* p = put_header(&out[at], Type, static_cast<uint32_t>(n));
+    ((p = F::put(p, v)), ...);
+    return true;
+  }
+
+  // View ссылается на payload и живёт не дольше него.
+  static bool decode(std::string_view payload, View& out){
+    if (payload.size() < kMinSize) return false;
+    const char* p = payload.data();
+    return decode_fields(p, p + payload.size(), out, std::index_sequence_for<F...>{});
+  }
+
+private:
+  template <std::size_t... I>
+  static bool decode_fields(const char* p, const char* end, View& out, std::index_sequence<I...>){
+    return (F::get(p, end, std::get<I>(out)) && ...);
+  }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "stats/stats.hpp"
+#include "util/utils.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace lanchat {
+
+std::atomic<int64_t>& Stats::slot(const std::string& name){
+  return values_.try_emplace(name, 0).first->second;
+}
+
+Stats::Counter Stats::counter(const std::string& name){
+  std::lock_guard<std::mutex> lk(mx_);
+  return Counter(&slot(name));
+}
+
+void Stats::set(const std::string& name, int64_t v){
+  std::lock_guard<std::mutex> lk(mx_);
+  slot(name).store(v, std::memory_order_relaxed);
+}
+
+void Stats::add(const std::string& name, int64_t delta){
+  std::lock_guard<std::mutex> lk(mx_);
+  slot(name).fetch_add(delta, std::memory_order_relaxed);
+}
+
+int64_t Stats::get(const std::string& name){
+  std::lock_guard<std::mutex> lk(mx_);
+  auto it = values_.find(name);
+  return it == values_.end() ? 0 : it->second.load(std::memory_order_relaxed);
+}
+
+std::string Stats::render(){
+  std::ostringstream out;
+  std::lock_guard<std::mutex> lk(mx_);
+  out << "ts_ms " << now_ms() << "\n";
+  for (const auto& kv : values_) out << kv.first << " " << kv.second.load(std::memory_order_relaxed) << "\n";
+  return out.str();
+}
+
+bool Stats::write_file(const std::string& path){
+  const std::string text = render();
+  const std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc | std::ios::binary);
+    if (!out.is_open()) return false;
+    out << text;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  return !ec;
+}
+
+}
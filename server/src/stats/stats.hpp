@@ -0,0 +1,51 @@
+#ifndef LANCHAT_STATS_STATS_HPP
+#define LANCHAT_STATS_STATS_HPP
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <map>
+
+namespace lanchat {
+
+/**
+ * Простой реестр метрик "имя -> значение".
+ * Сервер периодически сбрасывает его в <data>/stats.txt.
+ * Горячие пути берут Counter один раз заранее: дальше инкремент — одна
+ * атомарная операция, без поиска по имени и без общего мьютекса.
+ */
+class Stats {
+public:
+  class Counter {
+  public:
+    Counter() = default;
+    void add(int64_t delta) const { if (v_) v_->fetch_add(delta, std::memory_order_relaxed); }
+    void set(int64_t v) const { if (v_) v_->store(v, std::memory_order_relaxed); }
+
+  private:
+    friend class Stats;
+    explicit Counter(std::atomic<int64_t>* v) : v_(v) {}
+    std::atomic<int64_t>* v_ = nullptr;
+  };
+
+  // Регистрирует метрику (если её ещё нет); Counter действителен, пока жив Stats.
+  Counter counter(const std::string& name);
+
+  void set(const std::string& name, int64_t v);
+  void add(const std::string& name, int64_t delta);
+  int64_t get(const std::string& name);
+
+  std::string render();
+  bool write_file(const std::string& path);
+
+private:
+  std::atomic<int64_t>& slot(const std::string& name);
+
+  std::mutex mx_;
+  std::map<std::string, std::atomic<int64_t>> values_;   // узлы map не переезжают
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "stats/trace.hpp"
+#include "util/utils.hpp"
+
+#include <filesystem>
+#include <chrono>
+
+namespace lanchat {
+
+static constexpr uint64_t kMaxEvents  = 2000000;
+static constexpr size_t   kMaxPending = 65536;
+
+static thread_local uint64_t t_current = 0;
+static std::atomic<uint32_t> g_next_tid{1};
+
+static uint32_t thread_tid(){
+  static thread_local uint32_t tid = g_next_tid.fetch_add(1);
+  return tid;
+}
+
+static uint64_t steady_ns(){
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Tracer::~Tracer(){ close(); }
+
+bool Tracer::open(const std::string& data_dir, double rate){
+  if (rate <= 0.0) return false;
+  const auto p = std::filesystem::path(data_dir) / ("trace-" + std::to_string(now_ms()) + ".json");
+  {
+    std::lock_guard<std::mutex> lk(file_mx_);
+    out_.open(p.string(), std::ios::trunc | std::ios::binary);
+    if (!out_.is_open()) return false;
+    out_ << "[\n";
+    first_ = true;
+  }
+  rate_ = rate > 1.0 ? 1.0 : rate;
+  origin_ns_ = steady_ns();
+  enabled_ = true;
+  return true;
+}
+
+void Tracer::close(){
+  enabled_ = false;
+  flush();
+  std::lock_guard<std::mutex> lk(file_mx_);
+  if (!out_.is_open()) return;
+  out_ << "\n]\n";
+  out_.close();
+}
+
+uint64_t Tracer::now_us() const {
+  return (steady_ns() - origin_ns_) / 1000;
+}
+
+uint64_t Tracer::current(){ return t_current; }
+
+uint64_t Tracer::sample(){
+  if (!enabled()) return 0;
+  // Детерминированная выборка: каждое k-е сообщение, k = 1/rate.
+  const uint64_t n = seen_.fetch_add(1, std::memory_order_relaxed);
+  const uint64_t every = static_cast<uint64_t>(1.0 / rate_ + 0.5);
+  if (every > 1 && n % every != 0) return 0;
+  return next_id_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Tracer::record(const char* name, uint64_t id, uint64_t start_us, uint64_t dur_us){
+  std::lock_guard<std::mutex> lk(mx_);
+  if (pending_.size() >= kMaxPending) return;
+  pending_.push_back(Event{name, id, start_us, dur_us, thread_tid()});
+}
+
+void Tracer::flush(){
+  std::vector<Event> batch;
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    batch.swap(pending_);
+  }
+  if (batch.empty()) return;
+
+  std::string buf;
+  buf.reserve(batch.size() * 110);
+  for (const auto& e : batch){
+    buf += "{\"name\":\"";
+    buf += e.name;
+    buf += "\",\"cat\":\"msg\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+    buf += std::to_string(e.tid);
+    buf += ",\"ts\":";
+    buf += std::to_string(e.start_us);
+    buf += ",\"dur\":";
+    buf += std::to_string(e.dur_us);
+    buf += ",\"args\":{\"msg\":";
+    buf += std::to_string(e.id);
+    buf += "}},\n";
+  }
+
+  std::lock_guard<std::mutex> lk(file_mx_);
+  if (!out_.is_open()) return;
+  if (!first_) out_ << ",\n";
+  buf.resize(buf.size() - 2);
+  out_ << buf;
+  out_.flush();
+  first_ = false;
+  if (written_.fetch_add(batch.size()) + batch.size() >= kMaxEvents) enabled_ = false;
+}
+
+TraceSpan::TraceSpan(Tracer* t, const char* name)
+  : t_(t), name_(name), id_(t_current) {
+  if (id_ && t_) start_ = t_->now_us();
+}
+
+TraceSpan::TraceSpan(Tracer* t, const char* name, uint64_t id)
+  : t_(t), name_(name), id_(id) {
+  if (id_ && t_) start_ = t_->now_us();
+}
+
+TraceSpan::~TraceSpan(){
+  if (id_ && t_) t_->record(name_, id_, start_, t_->now_us() - start_);
+}
+
+uint64_t TraceMessage::enter(Tracer* t){
+  const uint64_t prev = t_current;
+  t_current = t ? t->sample() : 0;
+  return prev;
+}
+
+TraceMessage::~TraceMessage(){ t_current = prev_; }
+
+}
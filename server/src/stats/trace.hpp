@@ -0,0 +1,94 @@
+#ifndef LANCHAT_STATS_TRACE_HPP
+#define LANCHAT_STATS_TRACE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Выборочная трассировка конвейера сообщения в формате Chrome trace events
+ * (JSON Array Format, открывается в chrome://tracing и Perfetto).
+ * Решение о выборке принимается один раз на сообщение (TraceMessage);
+ * вложенные TraceSpan на том же потоке пишутся только для выбранных сообщений.
+ * События копятся в памяти и дописываются в <data>/trace-<ms>.json из flush().
+ */
+class Tracer {
+public:
+  ~Tracer();
+
+  bool open(const std::string& data_dir, double rate);
+  void close();
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  void record(const char* name, uint64_t id, uint64_t start_us, uint64_t dur_us);
+  void flush();
+  uint64_t events() const { return written_.load(); }
+
+  static uint64_t current();
+  uint64_t now_us() const;
+
+private:
+  friend class TraceMessage;
+  uint64_t sample();
+
+  struct Event {
+    const char* name;
+    uint64_t id;
+    uint64_t start_us;
+    uint64_t dur_us;
+    uint32_t tid;
+  };
+
+  std::atomic<bool> enabled_{false};
+  double rate_ = 0.0;
+  std::atomic<uint64_t> seen_{0};
+  std::atomic<uint64_t> next_id_{1};
+  std::atomic<uint64_t> written_{0};
+  uint64_t origin_ns_ = 0;
+
+  std::mutex mx_;
+  std::vector<Event> pending_;
+  std::mutex file_mx_;
+  std::ofstream out_;
+  bool first_ = true;
+};
+
+/** Замер одного этапа; ничего не делает, если текущее сообщение не в выборке. */
+class TraceSpan {
+public:
+  TraceSpan(Tracer* t, const char* name);
+  TraceSpan(Tracer* t, const char* name, uint64_t id);
+  ~TraceSpan();
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+  Tracer* t_;
+  const char* name_;
+  uint64_t id_;
+  uint64_t start_ = 0;
+};
+
+/** Корневой span сообщения: решает, попадает ли сообщение в выборку. */
+class TraceMessage {
+public:
+  TraceMessage(Tracer* t, const char* name) : prev_(enter(t)), span_(t, name) {}
+  ~TraceMessage();
+  TraceMessage(const TraceMessage&) = delete;
+  TraceMessage& operator=(const TraceMessage&) = delete;
+
+private:
+  static uint64_t enter(Tracer* t);
+
+  uint64_t prev_;
+  TraceSpan span_;
+};
+
+}
+
+#endif
@@ -0,0 +1,227 @@
+#include "storage/blobs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace lanchat {
+
+namespace fs = std::filesystem;
+
+bool BlobStore::open(const std::string& data_dir, uint64_t max_blob_bytes, uint64_t quota_bytes){
+  max_blob_ = max_blob_bytes;
+  quota_ = quota_bytes;
+  if (!max_blob_) return false;
+  dir_ = (fs::path(data_dir) / "blobs").string();
+  std::error_code ec;
+  fs::create_directories(fs::path(dir_) / "partial", ec);
+  if (ec){
+    max_blob_ = 0;
+    return false;
+  }
+  uint64_t used = 0;
+  for (fs::recursive_directory_iterator it(dir_, ec), end; !ec && it != end; it.increment(ec)){
+    std::error_code fe;
+    if (it->is_regular_file(fe)) used += it->file_size(fe);
+  }
+  used_ = used;
+  return true;
+}
+
+bool BlobStore::valid_id(std::string_view id){
+  if (id.size() != 64) return false;
+  for (char c : id){
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+  }
+  return true;
+}
+
+std::string BlobStore::path(const std::string& id) const {
+  return (fs::path(dir_) / id.substr(0, 2) / id).string();
+}
+
+std::string BlobStore::partial_path(const std::string& id, uint64_t size) const {
+  return (fs::path(dir_) / "partial" / (id + "-" + std::to_string(size) + ".part")).string();
+}
+
+bool BlobStore::stat(const std::string& id, uint64_t& size) const {
+  std::error_code ec;
+  const auto n = fs::file_size(path(id), ec);
+  if (ec) return false;
+  size = n;
+  return true;
+}
+
+bool BlobStore::reserve(uint64_t n){
+  uint64_t cur = used_.load();
+  do {
+    if (quota_ && cur + n > quota_) return false;
+  } while (!used_.compare_exchange_weak(cur, cur + n));
+  return true;
+}
+
+std::shared_ptr<BlobStore::Upload> BlobStore::upload(const std::string& part, uint64_t size, Put& err){
+  std::lock_guard<std::mutex> lk(mx_);
+  auto it = uploads_.find(part);
+  if (it != uploads_.end()) return it->second;
+  // Байты уже лежащего .part (загрузка до перезапуска) учтены в used_ при open().
+  std::error_code ec;
+  uint64_t cur = fs::file_size(part, ec);
+  if (ec) cur = 0;
+  if (cur > size){
+    err = Put::kIoError;
+    return nullptr;
+  }
+  if (!reserve(size - cur)){
+    err = Put::kQuota;
+    return nullptr;
+  }
+  auto u = std::make_shared<Upload>();
+  u->have = cur;
+  u->reserved = size - cur;
+  u->primed = cur == 0;
+  u->touched = std::chrono::steady_clock::now();
+  uploads_.emplace(part, u);
+  return u;
+}
+
+std::size_t BlobStore::sweep_partial(uint64_t max_age_sec){
+  const auto max_age = std::chrono::seconds(max_age_sec);
+  const auto now = std::chrono::steady_clock::now();
+  const auto cutoff = fs::file_time_type::clock::now() - max_age;
+  std::size_t removed = 0;
+  std::lock_guard<std::mutex> lk(mx_);
+  std::error_code ec;
+  for (auto it = uploads_.begin(); it != uploads_.end();){
+    Upload& u = *it->second;
+    // Занятую загрузку пропускаем: в неё сейчас пишут, значит она не брошена.
+    std::unique_lock<std::mutex> ul(u.mx, std::try_to_lock);
+    if (!ul.owns_lock() || now - u.touched < max_age){ ++it; continue; }
+    u.dead = true;
+    fs::remove(it->first, ec);
+    used_ -= u.have + u.reserved;
+    ++removed;
+    ul.unlock();
+    it = uploads_.erase(it);
+  }
+  // Файлы без записи в uploads_ — остались от прошлого запуска.
+  for (fs::directory_iterator it(fs::path(dir_) / "partial", ec), end; !ec && it != end; it.increment(ec)){
+    std::error_code fe;
+    if (!it->is_regular_file(fe) || it->last_write_time(fe) > cutoff || fe) continue;
+    if (uploads_.count(it->path().string())) continue;
+    const uint64_t n = it->file_size(fe);
+    if (fs::remove(it->path(), fe)){
+      used_ -= n;
+      ++removed;
+    }
+  }
+  return removed;
+}
+
+BlobStore::Put BlobStore::begin(const std::string& id, uint64_t size, uint64_t& have){
+  if (size > max_blob_) return Put::kTooLarge;
+  if (stat(id, have)){
+    ++dedup_;
+    return Put::kComplete;
+  }
+  Put err = Put::kPartial;
+  auto u = upload(partial_path(id, size), size, err);
+  if (!u) return err;
+  std::lock_guard<std::mutex> ul(u->mx);
+  have = u->dead ? 0 : u->have;
+  return Put::kPartial;
+}
+
+uint64_t BlobStore::have(const std::string& id, uint64_t size){
+  uint64_t n = 0;
+  if (stat(id, n)){
+    ++dedup_;
+    return n;
+  }
+  const std::string part = partial_path(id, size);
+  std::shared_ptr<Upload> u;
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    auto it = uploads_.find(part);
+    if (it != uploads_.end()) u = it->second;
+  }
+  if (u){
+    std::lock_guard<std::mutex> ul(u->mx);
+    if (!u->dead) return u->have;
+  }
+  std::error_code ec;
+  n = fs::file_size(part, ec);
+  return ec ? 0 : n;
+}
+
+BlobStore::Put BlobStore::put(const std::string& id, uint64_t size, uint64_t offset, std::string_view data){
+  if (size > max_blob_) return Put::kTooLarge;
+  uint64_t existing = 0;
+  if (stat(id, existing)) return Put::kComplete;
+
+  const std::string part = partial_path(id, size);
+  Put err = Put::kPartial;
+  // Обычно запись создана в begin(); без неё (ATTACH_CHUNK сразу после перезапуска) резервируем здесь.
+  auto u = upload(part, size, err);
+  if (!u) return err;
+
+  std::lock_guard<std::mutex> ul(u->mx);
+  // dead: загрузку только что завершил или снял другой поток — клиент переспросит have.
+  if (u->dead || offset != u->have || data.size() > size - offset) return Put::kBadOffset;
+  u->touched = std::chrono::steady_clock::now();
+  if (!u->primed){
+    // Продолжение загрузки прошлого запуска: один раз дочитываем уже записанное в хэш.
+    std::ifstream in(part, std::ios::binary);
+    std::vector<char> buf(64 * 1024);
+    uint64_t left = u->have;
+    while (left && in.read(buf.data(), static_cast<std::streamsize>(std::min<uint64_t>(left, buf.size())))){
+      u->sha.update(buf.data(), static_cast<std::size_t>(in.gcount()));
+      left -= static_cast<uint64_t>(in.gcount());
+    }
+    if (left) return Put::kIoError;
+    u->primed = true;
+  }
+  {
+    std::ofstream out(part, std::ios::binary | std::ios::app);
+    if (!out.write(data.data(), static_cast<std::streamsize>(data.size())) || !out.flush()){
+      out.close();
+      std::error_code ec;
+      fs::resize_file(part, u->have, ec);   // недописанный хвост сбил бы следующее смещение
+      return Put::kIoError;
+    }
+  }
+  u->sha.update(data.data(), data.size());
+  u->have += data.size();
+  u->reserved -= data.size();              // байты перешли из резерва в файл: used_ не меняется
+  if (u->have < size) return Put::kPartial;
+
+  // Запись убираем только после finish: иначе параллельный put завёл бы новую
+  // по ещё не перенесённому .part и учёл бы его байты в used_ второй раз.
+  u->dead = true;
+  const Put r = finish(id, part, size, u->sha.hex_final());
+  std::lock_guard<std::mutex> lk(mx_);
+  uploads_.erase(part);
+  return r;
+}
+
+BlobStore::Put BlobStore::finish(const std::string& id, const std::string& part, uint64_t size, const std::string& hex){
+  std::error_code ec;
+  if (hex != id){
+    if (fs::remove(part, ec)) used_ -= size;
+    return Put::kMismatch;
+  }
+  const fs::path dst = path(id);
+  fs::create_directories(dst.parent_path(), ec);
+  fs::rename(part, dst, ec);
+  if (ec){
+    if (fs::remove(part, ec)) used_ -= size;
+    uint64_t n = 0;
+    return stat(id, n) ? Put::kComplete : Put::kIoError;
+  }
+  ++stored_;
+  return Put::kComplete;
+}
+
+}
@@ -0,0 +1,83 @@
+#ifndef LANCHAT_STORAGE_BLOBS_HPP
+#define LANCHAT_STORAGE_BLOBS_HPP
+
+#include "hash/hash.hpp"
+
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Хранилище вложений с адресацией по содержимому: <data>/blobs/<2 hex>/<sha256>.
+ * Загрузка идёт кусками в blobs/partial/<sha256>-<size>.part строго по порядку
+ * смещений, поэтому прерванную загрузку можно продолжить с have().
+ * SHA-256 считается по ходу записи кусков, поэтому на последнем куске остаётся
+ * только сверить хэш и перенести файл на место; одинаковое содержимое хранится
+ * один раз.
+ * Квота общая на всё в blobs/: начатая загрузка сразу резервирует свой остаток,
+ * так что параллельные загрузки не могут вместе превысить квоту. Брошенные
+ * загрузки старше заданного возраста вместе с резервом снимает sweep_partial().
+ * Файлы хранятся открыто: шифрование лога на них не распространяется.
+ */
+class BlobStore {
+public:
+  enum class Put { kPartial, kComplete, kBadOffset, kTooLarge, kQuota, kMismatch, kIoError };
+
+  // quota_bytes 0 — без общего ограничения.
+  bool open(const std::string& data_dir, uint64_t max_blob_bytes, uint64_t quota_bytes);
+  bool enabled() const { return max_blob_ > 0; }
+  uint64_t max_blob() const { return max_blob_; }
+
+  static bool valid_id(std::string_view id);
+
+  // Начало или продолжение загрузки (ATTACH_BEGIN): резервирует остаток в квоте.
+  // kComplete — вложение уже есть, kPartial — продолжать с have, kQuota — места нет.
+  Put begin(const std::string& id, uint64_t size, uint64_t& have);
+  // Сколько байт уже есть: size для готового вложения, иначе длина незавершённой загрузки.
+  uint64_t have(const std::string& id, uint64_t size);
+  Put put(const std::string& id, uint64_t size, uint64_t offset, std::string_view data);
+  bool stat(const std::string& id, uint64_t& size) const;
+  std::string path(const std::string& id) const;
+  // Удалить незавершённые загрузки, не дописывавшиеся дольше max_age_sec; возвращает их число.
+  std::size_t sweep_partial(uint64_t max_age_sec);
+
+  uint64_t stored() const { return stored_.load(); }
+  uint64_t dedup_hits() const { return dedup_.load(); }
+  uint64_t used() const { return used_.load(); }
+
+private:
+  struct Upload {
+    std::mutex mx;
+    Sha256   sha;
+    uint64_t have = 0;                 // байт в .part (и в sha, если primed)
+    uint64_t reserved = 0;             // size - have: зарезервировано в used_
+    bool     primed = false;           // sha догнан до have (после перезапуска — дочитать файл)
+    bool     dead = false;             // загрузка завершена или снята sweep
+    std::chrono::steady_clock::time_point touched;
+  };
+
+  std::string partial_path(const std::string& id, uint64_t size) const;
+  bool reserve(uint64_t n);
+  std::shared_ptr<Upload> upload(const std::string& part, uint64_t size, Put& err);
+  Put finish(const std::string& id, const std::string& part, uint64_t size, const std::string& hex);
+
+  std::string dir_;
+  uint64_t    max_blob_ = 0;
+  uint64_t    quota_ = 0;
+  std::atomic<uint64_t> used_{0};      // байты файлов в blobs/ плюс резерв начатых загрузок
+  std::mutex  mx_;                     // uploads_ и каталог partial/
+  std::unordered_map<std::string, std::shared_ptr<Upload>> uploads_;   // по пути .part
+  std::atomic<uint64_t> stored_{0};
+  std::atomic<uint64_t> dedup_{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include "storage/compactor.hpp"
+#include "util/utils.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+
+namespace lanchat {
+
+static constexpr std::size_t kCopyChunk = 64 * 1024;
+
+Compactor::Compactor(const Config& cfg, Storage& storage, Stats& stats, std::function<void()> on_compacted)
+  : cfg_(cfg), storage_(storage), stats_(stats), on_compacted_(std::move(on_compacted)) {}
+
+Compactor::~Compactor(){ stop(); }
+
+void Compactor::start(){
+  if (!cfg_.retention_days && !cfg_.retention_mb) return;
+  if (th_.joinable()) return;
+  th_ = std::thread([this]{ loop(); });
+}
+
+void Compactor::stop(){
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (th_.joinable()) th_.join();
+}
+
+void Compactor::loop(){
+  const auto period = std::chrono::seconds(cfg_.compact_check_sec ? cfg_.compact_check_sec : 300);
+  std::unique_lock<std::mutex> lk(mx_);
+  while (!stop_){
+    lk.unlock();
+    run_once();
+    lk.lock();
+    cv_.wait_for(lk, period, [&]{ return stop_; });
+  }
+}
+
+void Compactor::throttle(std::size_t bytes){
+  if (!cfg_.compact_io_kbps) return;
+  const auto us = static_cast<int64_t>(bytes) * 1000000 / (static_cast<int64_t>(cfg_.compact_io_kbps) * 1024);
+  std::unique_lock<std::mutex> lk(mx_);
+  cv_.wait_for(lk, std::chrono::microseconds(us), [&]{ return stop_; });
+}
+
+uint64_t Compactor::find_cut(uint64_t phys_end){
+  const uint64_t min_ts = cfg_.retention_days
+    ? now_ms() - static_cast<uint64_t>(cfg_.retention_days) * 86400000ULL : 0;
+  const uint64_t max_bytes = static_cast<uint64_t>(cfg_.retention_mb) * 1024 * 1024;
+  const uint64_t size_cut = (max_bytes && phys_end > max_bytes) ? phys_end - max_bytes : 0;
+
+  std::ifstream in(storage_.log_path(), std::ios::binary);
+  if (!in.is_open()) return 0;
+
+  uint64_t pos = 0, scanned = 0;
+  std::string line;
+  while (pos < phys_end && std::getline(in, line)){
+    if (pos + line.size() + 1 > phys_end) break;
+    uint64_t ts = 0;
+    try { ts = std::stoull(line.substr(0, line.find('\t'))); }
+    catch (...) { ts = 0; }
+    if (pos >= size_cut && ts >= min_ts) break;
+    pos += line.size() + 1;
+    scanned += line.size() + 1;
+    if (scanned >= kCopyChunk){ throttle(scanned); scanned = 0; }
+    {
+      std::lock_guard<std::mutex> lk(mx_);
+      if (stop_) return 0;
+    }
+  }
+  return pos;
+}
+
+bool Compactor::copy_tail(uint64_t from, uint64_t to, const std::string& tmp){
+  std::ifstream in(storage_.log_path(), std::ios::binary);
+  std::ofstream out(tmp, std::ios::trunc | std::ios::binary);
+  if (!in.is_open() || !out.is_open()) return false;
+  in.seekg(static_cast<std::streamoff>(from));
+
+  std::vector<char> buf(kCopyChunk);
+  uint64_t left = to - from;
+  while (left > 0){
+    {
+      std::lock_guard<std::mutex> lk(mx_);
+      if (stop_) return false;
+    }
+    const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>(left, buf.size()));
+    in.read(buf.data(), static_cast<std::streamsize>(n));
+    if (static_cast<std::size_t>(in.gcount()) != n) return false;
+    out.write(buf.data(), static_cast<std::streamsize>(n));
+    left -= n;
+    throttle(n);
+  }
+  out.flush();
+  return out.good();
+}
+
+bool Compactor::run_once(){
+  const uint64_t t0 = now_ms();
+  const uint64_t base = storage_.log_base();
+  const uint64_t phys_end = storage_.log_offset() - base;
+  const uint64_t cut = find_cut(phys_end);
+  if (cut == 0) return false;
+
+  const std::string tmp = storage_.compact_path();
+  bool ok = copy_tail(cut, phys_end, tmp) && storage_.log_base() == base
+         && storage_.swap_compacted(tmp, cut, phys_end);
+  if (!ok){
+    std::error_code ec;
+    std::filesystem::remove(tmp, ec);
+    stats_.add("compact_failed", 1);
+    return false;
+  }
+
+  stats_.add("compact_runs", 1);
+  stats_.add("compact_reclaimed_bytes", static_cast<int64_t>(cut));
+  stats_.set("compact_last_reclaimed", static_cast<int64_t>(cut));
+  stats_.set("compact_last_ms", static_cast<int64_t>(now_ms() - t0));
+  stats_.set("log_base", static_cast<int64_t>(storage_.log_base()));
+  std::cout<<"Log compacted: reclaimed "<<cut<<" bytes\n";
+  if (on_compacted_) on_compacted_();
+  return true;
+}
+
+}
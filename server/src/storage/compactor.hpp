@@ -0,0 +1,53 @@
+#ifndef LANCHAT_STORAGE_COMPACTOR_HPP
+#define LANCHAT_STORAGE_COMPACTOR_HPP
+
+#include "storage/storage.hpp"
+#include "config/config.hpp"
+#include "stats/stats.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Фоновая очистка messages.log по возрасту (retention_days) и размеру (retention_mb).
+ * Сохраняемый хвост копируется во временный файл с ограничением скорости
+ * (compact_io_kbps), затем атомарно подменяет лог под блокировкой Storage.
+ * Логические offset'ы не меняются: отброшенные байты уходят в messages.base.
+ */
+class Compactor {
+public:
+  Compactor(const Config& cfg, Storage& storage, Stats& stats, std::function<void()> on_compacted);
+  ~Compactor();
+
+  void start();
+  void stop();
+
+  bool run_once();
+
+private:
+  void loop();
+  uint64_t find_cut(uint64_t phys_end);
+  bool copy_tail(uint64_t from, uint64_t to, const std::string& tmp);
+  void throttle(std::size_t bytes);
+
+private:
+  Config cfg_;
+  Storage& storage_;
+  Stats& stats_;
+  std::function<void()> on_compacted_;
+
+  std::mutex mx_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  std::thread th_;
+};
+
+}
+
+#endif
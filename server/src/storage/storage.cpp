@@ -4,9 +4,13 @@
 #include "hash/hash.hpp"
 
 #include <filesystem>
+#include <iostream>
+#include <cstring>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <string>
+#include <chrono>
 #include <mutex>
 
 namespace lanchat
@@ -22,114 +26,828 @@ static bool parse_blob_hex(const std::string& s, std::vector<uint8_t>& out_blob)
   return hex_decode(hex, out_blob);
 }
 
-Storage::Storage(std::size_t last_cap) : cap_(last_cap) {}
+static uint64_t line_seq(const std::string& line) {
+  size_t cols = 0, last = 0;
+  for (size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == '\t') { ++cols; last = i + 1; }
+  }
+  if (cols < 4) return 0;
+  uint64_t v = 0;
+  for (size_t i = last; i < line.size() && line[i] >= '0' && line[i] <= '9'; ++i)
+    v = v * 10 + static_cast<uint64_t>(line[i] - '0');
+  return v;
+}
+
+static uint64_t message_bytes(const Message& m) {
+  return sizeof(Message) + m.text.capacity();
+}
+
+// Сколько сообщений может ждать шифрования/записи, прежде чем append() начнёт тормозить отправителей.
+static constexpr uint64_t kMaxInflight = 4096;
+
+static constexpr char     kSnapMagic[4] = {'L','C','S','N'};
+static constexpr uint32_t kSnapVersion  = 4;
+
+static void put_u32(std::string& out, uint32_t v) {
+  uint32_t be = to_be32(v);
+  out.append(reinterpret_cast<const char*>(&be), 4);
+}
+
+static void put_u64(std::string& out, uint64_t v) {
+  uint64_t be = to_be64(v);
+  out.append(reinterpret_cast<const char*>(&be), 8);
+}
+
+static void put_str(std::string& out, const std::string& s) {
+  put_u32(out, static_cast<uint32_t>(s.size()));
+  out += s;
+}
+
+struct SnapReader {
+  const std::string& buf;
+  size_t off = 0;
+
+  bool u8(uint8_t& v) {
+    if (buf.size() < off + 1) return false;
+    v = static_cast<uint8_t>(buf[off++]);
+    return true;
+  }
+  bool u32(uint32_t& v) {
+    if (buf.size() < off + 4) return false;
+    uint32_t be; std::memcpy(&be, &buf[off], 4); off += 4;
+    v = from_be32(be);
+    return true;
+  }
+  bool u64(uint64_t& v) {
+    if (buf.size() < off + 8) return false;
+    uint64_t be; std::memcpy(&be, &buf[off], 8); off += 8;
+    v = from_be64(be);
+    return true;
+  }
+  bool str(std::string& s) {
+    uint32_t n = 0;
+    if (!u32(n) || buf.size() < off + n) return false;
+    s.assign(buf, off, n); off += n;
+    return true;
+  }
+};
+
+Storage::Storage(std::size_t last_cap, UserRegistry& users)
+  : cap_(last_cap), users_(users),
+    warm_([this](const std::string& line, Message& m){ return decode_line(line, m); }) {}
 
 bool Storage::open(const std::string& data_dir) {
   data_dir_ = data_dir;
   std::filesystem::create_directories(data_dir_);
-  const auto p = std::filesystem::path(data_dir_) / "messages.log";
-  log_.open(p.string(), std::ios::app);
+  const auto p = log_path();
+  log_.open(p, std::ios::app | std::ios::binary);
+  std::error_code ec;
+  auto sz = std::filesystem::file_size(p, ec);
+  log_size_ = ec ? 0 : static_cast<uint64_t>(sz);
+
+  recover_base();
+  std::ifstream base_in((std::filesystem::path(data_dir_) / "messages.base").string());
+  if (!(base_in >> log_base_)) log_base_ = 0;
+
+  const auto dm_path = (std::filesystem::path(data_dir_) / "dms.log").string();
+  dm_log_.open(dm_path, std::ios::app | std::ios::binary);
+  const auto dm_sz = std::filesystem::file_size(dm_path, ec);
+  dm_bytes_ = ec ? 0 : static_cast<uint64_t>(dm_sz);
   return log_.is_open();
 }
 
-bool Storage::load_from_log(std::size_t max_lines,
-                            std::unordered_set<std::string>& users_out) {
-  const auto p = std::filesystem::path(data_dir_) / "messages.log";
+std::string Storage::log_path() const {
+  return (std::filesystem::path(data_dir_) / "messages.log").string();
+}
+
+std::string Storage::compact_path() const {
+  return log_path() + ".compact";
+}
+
+void Storage::recover_base() {
+  // swap_compacted пишет новый base в messages.base.next до подмены лога.
+  // Если .compact на месте, подмена не состоялась и base.next отбрасывается,
+  // иначе лог уже новый и base.next становится messages.base.
+  const auto dir = std::filesystem::path(data_dir_);
+  std::error_code ec;
+  if (std::filesystem::exists(dir / "messages.base.next", ec)) {
+    if (std::filesystem::exists(compact_path(), ec)) std::filesystem::remove(dir / "messages.base.next", ec);
+    else std::filesystem::rename(dir / "messages.base.next", dir / "messages.base", ec);
+  }
+  std::filesystem::remove(compact_path(), ec);
+}
+
+bool Storage::persist_base(uint64_t base, const char* name) {
+  const auto p = std::filesystem::path(data_dir_) / name;
+  const auto tmp = std::filesystem::path(data_dir_) / "messages.base.tmp";
+  {
+    std::ofstream out(tmp.string(), std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << base << "\n";
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, p, ec);
+  return !ec;
+}
+
+bool Storage::decode_line(const std::string& line, Message& m) const {
+  std::vector<std::string> cols; cols.reserve(4);
+  std::string cur; cur.reserve(line.size());
+  for (char c : line) {
+    if (c=='\t'){ cols.push_back(cur); cur.clear(); }
+    else cur.push_back(c);
+  }
+  cols.push_back(cur);
+  if (cols.size() < 4) return false;
+
+  try { m.ts_ms = static_cast<uint64_t>(std::stoull(cols[0])); }
+  catch (...) { return false; }
+
+  const std::string& payload = cols[2];
+
+  if (is_legacy_gcm_line(payload)) {
+    return false;
+  } else if (payload.rfind("BLOB:", 0) == 0) {
+    if (!enc_enabled_) return false;
+    std::vector<uint8_t> blob;
+    if (!parse_blob_hex(payload, blob)) return false;
+    try {
+      const std::string secret(enc_key_.begin(), enc_key_.end());
+      auto rec = crypto::decrypt(secret, blob);
+      m.text.assign(rec.begin(), rec.end());
+    } catch (...) {
+      return false;
+    }
+  } else {
+    m.text = unescape_tsv(payload);
+  }
+
+  try { m.hash = static_cast<uint64_t>(std::stoull(cols[3], nullptr, 16)); }
+  catch (...) { m.hash = 0; }
+  m.seq = 0;
+  if (cols.size() >= 5) {
+    try { m.seq = static_cast<uint64_t>(std::stoull(cols[4])); }
+    catch (...) { m.seq = 0; }
+  }
+  m.user_id = users_.intern(unescape_tsv(cols[1]));
+  return true;
+}
+
+std::string Storage::encode_payload(const std::string& text) const {
+  if (enc_enabled_) {
+    try {
+      const std::string secret(enc_key_.begin(), enc_key_.end());
+      crypto::EncryptedBlob b = crypto::encrypt(
+        secret,
+        std::vector<uint8_t>(text.begin(), text.end())
+      );
+      return "BLOB:" + hex_encode(b.data);
+    } catch (...) {
+    }
+  }
+  return escape_tsv(text);
+}
+
+std::string Storage::encode_line(const Message& m) const {
+  return std::to_string(m.ts_ms) + '\t'
+       + escape_tsv(users_.name(m.user_id)) + '\t'
+       + encode_payload(m.text) + '\t'
+       + hex64(m.hash) + '\t'
+       + std::to_string(m.seq) + '\n';
+}
+
+void Storage::push_ring(Message m) {
+  std::lock_guard<std::mutex> lk(mx_);
+  if (ring_.size() >= cap_) {
+    ring_bytes_ -= message_bytes(ring_.front());
+    ring_.pop_front();
+  }
+  ring_bytes_ += message_bytes(m);
+  ring_.push_back(std::move(m));
+}
+
+void Storage::push_ring_front(Message m) {
+  std::lock_guard<std::mutex> lk(mx_);
+  if (ring_.size() >= cap_) return;
+  ring_bytes_ += message_bytes(m);
+  ring_.push_front(std::move(m));
+}
+
+void Storage::write_locked(const std::string& data) {
+  log_.write(data.data(), static_cast<std::streamsize>(data.size()));
+  log_.flush();
+  log_size_ += data.size();
+}
+
+void Storage::write_log(const std::string& data, std::vector<Message> ring_adds) {
+  uint64_t seq_end = 0;
+  {
+    std::lock_guard<std::mutex> lk(log_mx_);
+    const uint64_t start = log_base_ + log_size_;
+    for (auto& m : ring_adds) {
+      m.offset += start;
+      seq_end = std::max(seq_end, m.seq + 1);
+      push_ring(std::move(m));
+    }
+    written_seq_ = std::max(written_seq_, seq_end);
+    write_locked(data);
+  }
+  log_cv_.notify_all();
+
+  std::lock_guard<std::mutex> lk(commit_mx_);
+  if (seq_end > next_seq_) next_seq_ = next_commit_ = seq_end;
+}
+
+bool Storage::load_from_log(std::size_t max_lines) {
+  const auto p = log_path();
   if (!std::filesystem::exists(p)) return true;
 
-  std::vector<std::string> lines;
+  std::deque<std::pair<uint64_t, std::string>> lines;
   {
-    std::ifstream in(p.string());
+    std::ifstream in(p, std::ios::binary);
     if (!in.is_open()) return false;
     std::string line;
+    uint64_t pos = 0;
     while (std::getline(in, line)) {
-      lines.push_back(std::move(line));
-      if (lines.size() > max_lines) lines.erase(lines.begin());
+      const uint64_t next = pos + line.size() + 1;
+      const uint64_t seq = line_seq(line);
+      if (seq >= next_seq_) next_seq_ = seq + 1;
+      lines.emplace_back(pos, std::move(line));
+      if (lines.size() > max_lines) lines.pop_front();
+      pos = next;
     }
   }
 
-  for (const auto& line : lines) {
-    std::vector<std::string> cols; cols.reserve(4);
-    std::string cur; cur.reserve(line.size());
-    for (char c : line) {
-      if (c=='\t'){ cols.push_back(cur); cur.clear(); }
-      else cur.push_back(c);
+  const uint64_t base = log_base();
+  next_commit_ = written_seq_ = next_seq_;
+  if (pool_ && pool_->running() && enc_enabled_ && !lines.empty()) {
+    // Каждая строка BLOB: — это PBKDF2 на расшифровке; последовательно тысячи строк
+    // занимают минуты. Расшифровка уходит в пул, а сервер тем временем слушает.
+    {
+      std::lock_guard<std::mutex> lk(load_mx_);
+      load_lines_.reserve(lines.size());
+      for (auto it = lines.rbegin(); it != lines.rend(); ++it)
+        load_lines_.emplace_back(base + it->first, std::move(it->second));
+      load_t0_ = now_ms();
+      warming_ = true;
     }
-    cols.push_back(cur);
-    if (cols.size() < 4) continue;
-
+    warm_fill();
+    return true;
+  }
+  for (const auto& [pos, line] : lines) {
     Message m{};
-    try { m.ts_ms = static_cast<uint64_t>(std::stoull(cols[0])); }
-    catch (...) { continue; }
-
-    m.user = unescape_tsv(cols[1]);
-    const std::string& payload = cols[2];
-
-    if (is_legacy_gcm_line(payload)) {
-      continue;
-    } else if (payload.rfind("BLOB:", 0) == 0) {
-      if (!enc_enabled_) continue;
-      std::vector<uint8_t> blob;
-      if (!parse_blob_hex(payload, blob)) continue;
-      try {
-        const std::string secret(enc_key_.begin(), enc_key_.end());
-        auto rec = crypto::decrypt(secret, blob);
-        m.text.assign(rec.begin(), rec.end());
-      } catch (...) {
-        continue;
+    if (!decode_line(line, m)) continue;
+    m.offset = base + pos;
+    push_ring(std::move(m));
+  }
+  return true;
+}
+
+void Storage::warm_fill() {
+  // Окно в число потоков пула: задачи шифрования новых сообщений не ждут
+  // за всем хвостом лога, а встают в очереди между строками загрузки.
+  std::vector<std::size_t> ranks;
+  {
+    std::lock_guard<std::mutex> lk(load_mx_);
+    while (!load_abort_ && load_running_ < pool_->threads() && load_submitted_ < load_lines_.size()) {
+      ranks.push_back(load_submitted_++);
+      ++load_running_;
+    }
+  }
+  for (std::size_t rank : ranks) pool_->submit([this, rank]{ warm_one(rank); });
+}
+
+void Storage::warm_one(std::size_t rank) {
+  std::string line;
+  uint64_t offset = 0;
+  bool skip = false;
+  {
+    std::lock_guard<std::mutex> lk(load_mx_);
+    skip = load_abort_;
+    offset = load_lines_[rank].first;
+    line = std::move(load_lines_[rank].second);
+  }
+  {
+    // Кольцо уже заполнено новыми сообщениями — более старые строки не нужны.
+    std::lock_guard<std::mutex> lk(mx_);
+    skip = skip || ring_.size() >= cap_;
+  }
+  Message m{};
+  const bool ok = !skip && decode_line(line, m);
+  m.offset = offset;
+  {
+    std::lock_guard<std::mutex> lk(load_mx_);
+    --load_running_;
+    load_ready_.emplace(rank, std::make_pair(ok, std::move(m)));
+    while (!load_ready_.empty() && load_ready_.begin()->first == load_inserted_) {
+      auto& ready = load_ready_.begin()->second;
+      if (ready.first) push_ring_front(std::move(ready.second));
+      load_ready_.erase(load_ready_.begin());
+      ++load_inserted_;
+    }
+    if (load_inserted_ == load_lines_.size()) {
+      load_lines_.clear();
+      load_lines_.shrink_to_fit();
+      warm_ms_ = now_ms() - load_t0_;
+      warming_ = false;
+    }
+  }
+  load_cv_.notify_all();
+  warm_fill();
+}
+
+void Storage::stop_warmup() {
+  std::unique_lock<std::mutex> lk(load_mx_);
+  load_abort_ = true;
+  load_cv_.wait(lk, [&]{ return load_running_ == 0; });
+}
+
+void Storage::append(Message& m, PrepareFn prepare) {
+  {
+    std::unique_lock<std::mutex> lk(commit_mx_);
+    commit_cv_.wait(lk, [&]{ return next_seq_ - next_commit_ < kMaxInflight; });
+    m.seq = next_seq_++;
+  }
+
+  auto job = [this, msg = m, prepare = std::move(prepare), trace = Tracer::current()]() mutable {
+    Pending p;
+    {
+      TraceSpan span(tracer_, "encode", trace);
+      if (prepare) prepare(msg);
+      p.line = encode_line(msg);
+    }
+    p.m = std::move(msg);
+    p.trace = trace;
+    complete(std::move(p));
+  };
+  if (pool_ && enc_enabled_) pool_->submit(std::move(job));
+  else job();
+}
+
+void Storage::complete(Pending p) {
+  std::unique_lock<std::mutex> lk(commit_mx_);
+  reorder_.emplace(p.m.seq, std::move(p));
+  if (committing_) return;
+
+  // Пишет тот поток, который застал очередь свободной; остальные только
+  // оставляют свои строки в reorder_. Готовые подряд строки уходят одной записью.
+  committing_ = true;
+  while (!reorder_.empty() && reorder_.begin()->first == next_commit_) {
+    std::vector<Pending> batch;
+    while (!reorder_.empty() && reorder_.begin()->first == next_commit_) {
+      batch.push_back(std::move(reorder_.begin()->second));
+      reorder_.erase(reorder_.begin());
+      ++next_commit_;
+    }
+    lk.unlock();
+    commit_batch(batch);
+    lk.lock();
+  }
+  committing_ = false;
+  lk.unlock();
+  commit_cv_.notify_all();
+}
+
+void Storage::commit_batch(std::vector<Pending>& batch) {
+  {
+    std::lock_guard<std::mutex> lk(log_mx_);
+    std::string data;
+    const bool open = log_.is_open();
+    for (auto& p : batch) {
+      if (open) {
+        p.m.offset = log_base_ + log_size_ + data.size();
+        data += p.line;
       }
-    } else {
-      m.text = unescape_tsv(payload);
+      written_seq_ = p.m.seq + 1;
     }
+    if (!data.empty()) {
+      TraceSpan span(tracer_, "log.write", batch.front().trace);
+      write_locked(data);
+    }
+    for (auto& p : batch) {
+      if (on_commit_) push_ring(p.m);
+      else push_ring(std::move(p.m));
+    }
+  }
+  log_cv_.notify_all();
+  if (!on_commit_) return;
+  for (const auto& p : batch) on_commit_(p.m, p.trace);
+}
+
+void Storage::drain() {
+  std::unique_lock<std::mutex> lk(commit_mx_);
+  commit_cv_.wait(lk, [&]{ return !committing_ && next_commit_ == next_seq_; });
+}
+
+std::size_t Storage::inflight() {
+  std::lock_guard<std::mutex> lk(commit_mx_);
+  return static_cast<std::size_t>(next_seq_ - next_commit_);
+}
+
+bool Storage::append_direct(const DirectMessage& m) {
+  if (pool_ && enc_enabled_ && pool_->running()) {
+    pool_->submit([this, m]{ write_direct(m); });
+    return true;
+  }
+  return write_direct(m);
+}
+
+bool Storage::write_direct(const DirectMessage& m) {
+  const std::string line = std::to_string(m.ts_ms) + '\t'
+                         + escape_tsv(users_.name(m.from_id)) + '\t'
+                         + escape_tsv(users_.name(m.to_id)) + '\t'
+                         + encode_payload(m.text) + '\t'
+                         + hex64(m.hash) + '\n';
+  std::lock_guard<std::mutex> lk(dm_mx_);
+  if (!dm_log_.is_open()) return false;
+  dm_log_.write(line.data(), static_cast<std::streamsize>(line.size()));
+  dm_log_.flush();
+  dm_bytes_ += line.size();
+  return dm_log_.good();
+}
+
+uint64_t Storage::avg_message_bytes() {
+  std::lock_guard<std::mutex> lk(mx_);
+  return ring_.empty() ? sizeof(Message) + 64 : ring_bytes_.load() / ring_.size();
+}
 
-    m.hash_hex = cols[3];
-    users_out.insert(m.user);
+std::vector<Message> Storage::last(std::size_t n) {
+  std::lock_guard<std::mutex> lk(mx_);
+  if (n > ring_.size()) n = ring_.size();
+  return std::vector<Message>(ring_.end()-n, ring_.end());
+}
 
+std::vector<Message> Storage::history(uint64_t before_offset, std::size_t limit) {
+  std::vector<Message> out;
+  uint64_t oldest = UINT64_MAX;
+  {
     std::lock_guard<std::mutex> lk(mx_);
-    if (ring_.size() >= cap_) ring_.erase(ring_.begin());
-    ring_.push_back(std::move(m));
+    if (!ring_.empty()) oldest = ring_.front().offset;
+    for (auto it = ring_.rbegin(); it != ring_.rend() && out.size() < limit; ++it) {
+      if (it->offset < before_offset) out.push_back(*it);
+    }
   }
-  return true;
+  std::reverse(out.begin(), out.end());
+  if (out.size() >= limit || data_dir_.empty()) return out;
+
+  uint64_t gen = 0, base = 0, size = 0;
+  {
+    std::lock_guard<std::mutex> lk(log_mx_);
+    gen = log_gen_;
+    base = log_base_;
+    size = log_size_;
+    oldest = std::min(oldest, base + size);
+  }
+  oldest = std::min(oldest, before_offset);
+  auto older = warm_.query(log_path(), gen, base, size, oldest, limit - out.size());
+  older.insert(older.end(), std::make_move_iterator(out.begin()), std::make_move_iterator(out.end()));
+  return older;
 }
 
-void Storage::append(const Message& m) {
+bool Storage::since(uint64_t seq, std::size_t max, std::vector<Message>& out, uint64_t upto, std::size_t max_scan) {
+  out.clear();
+  uint64_t oldest = 0;
+  {
+    // Граница — записанное, а не выданное: seq в полёте нет ни в кольце, ни в логе.
+    std::lock_guard<std::mutex> lk(log_mx_);
+    if (seq >= written_seq_) return false;
+    oldest = written_seq_;
+    upto = std::min(upto, written_seq_ - 1);
+  }
+  auto wanted = [&](const Message& m){ return m.seq > seq && m.seq <= upto; };
   {
     std::lock_guard<std::mutex> lk(mx_);
-    if (ring_.size() >= cap_) ring_.erase(ring_.begin());
-    ring_.push_back(m);
+    if (!ring_.empty() && ring_.front().seq && ring_.front().seq <= seq + 1) {
+      for (const auto& m : ring_) if (wanted(m)) out.push_back(m);
+      return out.size() <= max;
+    }
+    if (!ring_.empty()) oldest = ring_.front().seq;
+  }
+
+  // Цена ответа — не число нужных сообщений, а число строк лога между seq
+  // и началом кольца: каждую читать и расшифровывать, даже если upto отсекает
+  // большую часть. Больше max_scan строк — отказ сразу, без чтения.
+  if (!max_scan) max_scan = max;
+  if (oldest && oldest - seq - 1 > max_scan) return false;
+  std::size_t scanned = 0;
+  uint64_t before = UINT64_MAX;
+  while (out.size() <= max) {
+    if (scanned > max_scan + cap_) return false;
+    auto page = history(before, 256);
+    if (page.empty()) return false;
+    scanned += page.size();
+    const uint64_t oldest_seq = page.front().seq;
+    const uint64_t oldest_offset = page.front().offset;
+    std::vector<Message> keep;
+    for (auto& m : page) if (wanted(m)) keep.push_back(std::move(m));
+    out.insert(out.begin(), std::make_move_iterator(keep.begin()), std::make_move_iterator(keep.end()));
+    if (oldest_seq && oldest_seq <= seq + 1) return out.size() <= max;
+    if (!oldest_seq || oldest_offset == 0) return false;
+    before = oldest_offset;
+  }
+  return false;
+}
+
+uint64_t Storage::log_offset() {
+  std::lock_guard<std::mutex> lk(log_mx_);
+  return log_base_ + log_size_;
+}
+
+uint64_t Storage::log_base() {
+  std::lock_guard<std::mutex> lk(log_mx_);
+  return log_base_;
+}
+
+bool Storage::wait_log(uint64_t offset, int timeout_ms) {
+  std::unique_lock<std::mutex> lk(log_mx_);
+  return log_cv_.wait_for(lk, std::chrono::milliseconds(timeout_ms),
+                          [&]{ return log_base_ + log_size_ > offset; });
+}
+
+bool Storage::read_log(uint64_t from, std::size_t max_bytes, std::string& out) {
+  out.clear();
+  uint64_t base = 0, end = 0;
+  {
+    std::unique_lock<std::mutex> lk(log_mx_);
+    log_cv_.wait(lk, [&]{ return !log_swapping_; });
+    base = log_base_;
+    end = log_base_ + log_size_;
+    if (from < base) return false;
+    if (from >= end) return from == end;
+    ++log_readers_;
   }
+  struct Release {
+    Storage& s;
+    ~Release(){
+      { std::lock_guard<std::mutex> lk(s.log_mx_); --s.log_readers_; }
+      s.log_cv_.notify_all();
+    }
+  } release{*this};
+  std::ifstream in(log_path(), std::ios::binary);
+  if (!in.is_open()) return false;
+  from -= base;
+  end -= base;
+  in.seekg(static_cast<std::streamoff>(from));
+
+  std::size_t want = static_cast<std::size_t>(std::min<uint64_t>(end - from, max_bytes));
+  out.resize(want);
+  in.read(&out[0], static_cast<std::streamsize>(want));
+  out.resize(static_cast<std::size_t>(in.gcount()));
+
+  size_t nl = out.rfind('\n');
+  if (nl == std::string::npos) {
+    if (out.size() < max_bytes) { out.clear(); return true; }
+    std::string line;
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(from));
+    if (!std::getline(in, line)) return false;
+    out = line + '\n';
+    return true;
+  }
+  out.resize(nl + 1);
+  return true;
+}
+
+bool Storage::append_raw(const std::string& chunk, std::vector<Message>& parsed) {
+  if (!log_.is_open()) return false;
+
+  const size_t first = parsed.size();
+  size_t start = 0;
+  while (start < chunk.size()) {
+    size_t nl = chunk.find('\n', start);
+    if (nl == std::string::npos) nl = chunk.size();
+    Message m{};
+    if (decode_line(chunk.substr(start, nl - start), m)) {
+      m.offset = start;
+      parsed.push_back(std::move(m));
+    }
+    start = nl + 1;
+  }
+  write_log(chunk, std::vector<Message>(parsed.begin() + first, parsed.end()));
+  return true;
+}
 
-  if (!log_.is_open()) return;
+bool Storage::save_snapshot() {
+  std::string body;
+  uint64_t offset = 0;
+  {
+    std::lock_guard<std::mutex> lk(log_mx_);
+    const std::vector<std::string> users = users_.names();
+    offset = log_base_ + log_size_;
+    put_u64(body, written_seq_);
+    std::lock_guard<std::mutex> rk(mx_);
+    put_u32(body, static_cast<uint32_t>(users.size()));
+    for (const auto& u : users) put_str(body, u);
+    put_u32(body, static_cast<uint32_t>(ring_.size()));
+    for (const auto& m : ring_) {
+      put_u64(body, m.ts_ms);
+      put_u32(body, m.user_id);
+      put_str(body, m.text);
+      put_u64(body, m.hash);
+      put_u64(body, m.offset);
+      put_u64(body, m.seq);
+    }
+  }
 
+  uint8_t encrypted = 0;
   if (enc_enabled_) {
     try {
       const std::string secret(enc_key_.begin(), enc_key_.end());
-      crypto::EncryptedBlob b = crypto::encrypt(
-        secret,
-        std::vector<uint8_t>(m.text.begin(), m.text.end())
-      );
-      const std::string blob_hex = hex_encode(b.data);
-      log_ << m.ts_ms << '\t'
-           << escape_tsv(m.user) << '\t'
-           << "BLOB:" << blob_hex << '\t'
-           << m.hash_hex << '\n';
-      log_.flush();
-      return;
+      auto b = crypto::encrypt(secret, std::vector<uint8_t>(body.begin(), body.end()));
+      body.assign(b.data.begin(), b.data.end());
+      encrypted = 1;
     } catch (...) {
+      return false;
     }
   }
 
-  log_ << m.ts_ms << '\t'
-       << escape_tsv(m.user) << '\t'
-       << escape_tsv(m.text) << '\t'
-       << m.hash_hex << '\n';
-  log_.flush();
+  std::string file(kSnapMagic, 4);
+  put_u32(file, kSnapVersion);
+  file.push_back(static_cast<char>(encrypted));
+  put_u64(file, offset);
+  put_u64(file, fnv1a64(body));
+  put_str(file, body);
+
+  const auto p = std::filesystem::path(data_dir_) / "snapshot.bin";
+  const auto tmp = std::filesystem::path(data_dir_) / "snapshot.bin.tmp";
+  {
+    std::ofstream out(tmp.string(), std::ios::trunc | std::ios::binary);
+    if (!out.is_open()) return false;
+    out.write(file.data(), static_cast<std::streamsize>(file.size()));
+    out.flush();
+    if (!out.good()) return false;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, p, ec);
+  return !ec;
 }
 
-std::vector<Message> Storage::last(std::size_t n) {
-  std::lock_guard<std::mutex> lk(mx_);
-  if (n >= ring_.size()) return ring_;
-  return std::vector<Message>(ring_.end()-n, ring_.end());
+bool Storage::load_snapshot() {
+  const auto p = std::filesystem::path(data_dir_) / "snapshot.bin";
+  std::string file;
+  {
+    std::ifstream in(p.string(), std::ios::binary);
+    if (!in.is_open()) return false;
+    file.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  SnapReader hdr{file};
+  uint32_t version = 0; uint8_t encrypted = 0; uint64_t offset = 0, sum = 0;
+  std::string body;
+  if (file.size() < 4 || std::memcmp(file.data(), kSnapMagic, 4) != 0) return false;
+  hdr.off = 4;
+  if (!hdr.u32(version) || version != kSnapVersion) return false;
+  if (!hdr.u8(encrypted) || !hdr.u64(offset) || !hdr.u64(sum) || !hdr.str(body)) return false;
+  if (fnv1a64(body) != sum) return false;
+  if (offset > log_offset()) return false;
+  const uint64_t base = log_base();
+  const uint64_t phys = offset > base ? offset - base : 0;
+
+  if (encrypted) {
+    if (!enc_enabled_) return false;
+    try {
+      const std::string secret(enc_key_.begin(), enc_key_.end());
+      auto rec = crypto::decrypt(secret, std::vector<uint8_t>(body.begin(), body.end()));
+      body.assign(rec.begin(), rec.end());
+    } catch (...) {
+      return false;
+    }
+  }
+
+  if (phys > 0) {
+    std::ifstream chk(log_path(), std::ios::binary);
+    char prev = 0;
+    chk.seekg(static_cast<std::streamoff>(phys - 1));
+    if (!chk.get(prev) || prev != '\n') return false;
+  }
+
+  SnapReader r{body};
+  std::vector<std::string> users;
+  std::vector<Message> ring;
+  uint32_t n = 0;
+  uint64_t next_seq = 1;
+  if (!r.u64(next_seq) || !r.u32(n)) return false;
+  for (uint32_t i = 0; i < n; ++i) {
+    std::string u;
+    if (!r.str(u)) return false;
+    users.push_back(std::move(u));
+  }
+  if (!r.u32(n)) return false;
+  ring.reserve(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    Message m;
+    if (!r.u64(m.ts_ms) || !r.u32(m.user_id) || !r.str(m.text) || !r.u64(m.hash) || !r.u64(m.offset) || !r.u64(m.seq)) return false;
+    if (m.user_id >= users.size()) return false;
+    ring.push_back(std::move(m));
+  }
+
+  std::vector<uint32_t> remap;
+  remap.reserve(users.size());
+  for (const auto& u : users) remap.push_back(users_.intern(u));
+  for (auto& m : ring) m.user_id = remap[m.user_id];
+
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    if (ring.size() > cap_) ring.erase(ring.begin(), ring.end() - cap_);
+    ring_.assign(std::make_move_iterator(ring.begin()), std::make_move_iterator(ring.end()));
+    uint64_t bytes = 0;
+    for (const auto& m : ring_) bytes += message_bytes(m);
+    ring_bytes_ = bytes;
+  }
+
+  next_seq_ = std::max(next_seq_, next_seq);
+
+  std::size_t replayed = 0;
+  std::ifstream in(log_path(), std::ios::binary);
+  if (in.is_open()) {
+    in.seekg(static_cast<std::streamoff>(phys));
+    std::string line;
+    uint64_t pos = base + phys;
+    while (std::getline(in, line)) {
+      Message m{};
+      const uint64_t at = pos;
+      pos += line.size() + 1;
+      const uint64_t seq = line_seq(line);
+      if (seq >= next_seq_) next_seq_ = seq + 1;
+      if (!decode_line(line, m)) continue;
+      m.offset = at;
+      push_ring(std::move(m));
+      ++replayed;
+    }
+  }
+  next_commit_ = written_seq_ = next_seq_;
+  std::cout << "Snapshot loaded: offset=" << offset
+            << " ring=" << n << " replayed=" << replayed << "\n";
+  return true;
+}
+
+bool Storage::skip_to(uint64_t offset) {
+  {
+    std::unique_lock<std::mutex> lk(log_mx_);
+    if (offset <= log_base_ + log_size_) return true;
+    // Байты до разрыва не совпадают с offset'ами лидера после него: лог начинается
+    // заново с offset, иначе read_log, history и отрезки компактора указывали бы мимо записей.
+    log_swapping_ = true;
+    log_cv_.wait(lk, [&]{ return log_readers_ == 0; });
+    struct Done { Storage& s; ~Done(){ s.log_swapping_ = false; s.log_cv_.notify_all(); } } done{*this};
+
+    std::error_code ec;
+    std::filesystem::remove(std::filesystem::path(data_dir_) / "snapshot.bin", ec);
+    warm_.reset(++log_gen_);
+    log_.close();
+    log_.open(log_path(), std::ios::trunc | std::ios::binary);
+    log_.close();
+    log_.open(log_path(), std::ios::app | std::ios::binary);
+    if (!log_.is_open()) return false;
+    log_base_ = offset;
+    log_size_ = 0;
+  }
+  // base пишется после усечения: если процесс упадёт между ними, пустой лог со старым
+  // base подпишется с прежнего offset, и лидер снова пришлёт разрыв.
+  return persist_base(offset);
+}
+
+bool Storage::swap_compacted(const std::string& tmp_path, uint64_t cut, uint64_t copied_end) {
+  const auto dir = std::filesystem::path(data_dir_);
+  uint64_t base = 0;
+  {
+    std::unique_lock<std::mutex> lk(log_mx_);
+    // Открытый читателем лог на Windows не заменить: новых читателей
+    // не пускаем и ждём, пока текущие закроют файл.
+    log_swapping_ = true;
+    log_cv_.wait(lk, [&]{ return log_readers_ == 0; });
+    struct Done { Storage& s; ~Done(){ s.log_swapping_ = false; s.log_cv_.notify_all(); } } done{*this};
+
+    if (copied_end > log_size_ || cut > copied_end) return false;
+    if (copied_end < log_size_) {
+      std::ofstream out(tmp_path, std::ios::app | std::ios::binary);
+      std::ifstream in(log_path(), std::ios::binary);
+      if (!out.is_open() || !in.is_open()) return false;
+      in.seekg(static_cast<std::streamoff>(copied_end));
+      out << in.rdbuf();
+      out.flush();
+      if (!out.good()) return false;
+    }
+
+    base = log_base_ + cut;
+    if (!persist_base(base, "messages.base.next")) return false;
+    std::error_code ec;
+    std::filesystem::remove(dir / "snapshot.bin", ec);
+    warm_.reset(++log_gen_);
+    log_.close();
+    std::filesystem::rename(tmp_path, log_path(), ec);
+    log_.open(log_path(), std::ios::app | std::ios::binary);
+    if (ec) {
+      std::filesystem::remove(dir / "messages.base.next", ec);
+      return false;
+    }
+
+    log_base_ = base;
+    log_size_ -= cut;
+  }
+  std::error_code ec;
+  std::filesystem::rename(dir / "messages.base.next", dir / "messages.base", ec);
+  return true;
 }
 
 }
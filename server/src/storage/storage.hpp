@@ -1,20 +1,39 @@
 #ifndef LANCHAT_STORAGE_STORAGE_HPP
 #define LANCHAT_STORAGE_STORAGE_HPP
 
+#include "storage/users.hpp"
+#include "storage/warm.hpp"
+#include "stats/trace.hpp"
+#include "util/work_pool.hpp"
+
 #include <cstdint>
 #include <string>
+#include <functional>
 #include <vector>
-#include <unordered_set>
+#include <deque>
+#include <map>
+#include <atomic>
 #include <mutex>
 #include <fstream>
+#include <condition_variable>
 
 namespace lanchat {
 
 struct Message {
   uint64_t    ts_ms = 0;
-  std::string user;
+  uint32_t    user_id = UserRegistry::kNone;
+  std::string text;
+  uint64_t    hash = 0;
+  uint64_t    offset = 0;   // логический offset записи в messages.log
+  uint64_t    seq = 0;      // сквозной номер сообщения на этом сервере (0 — старая запись без номера)
+};
+
+struct DirectMessage {
+  uint64_t    ts_ms = 0;
+  uint32_t    from_id = UserRegistry::kNone;
+  uint32_t    to_id = UserRegistry::kNone;
   std::string text;
-  std::string hash_hex;
+  uint64_t    hash = 0;
 };
 
 struct GcmBlob {
@@ -25,28 +44,139 @@ struct GcmBlob {
 
 class Storage {
 public:
-  explicit Storage(std::size_t last_cap);
+  Storage(std::size_t last_cap, UserRegistry& users);
 
   bool open(const std::string& data_dir);
 
-  bool load_from_log(std::size_t max_lines, std::unordered_set<std::string>& users_out);
+  // С шифрованием и запущенным пулом читает только хвост лога и выдаёт seq, а строки
+  // расшифровываются в пуле в фоне: кольцо заполняется от новых сообщений к старым
+  // и всё время остаётся сплошным хвостом лога, так что клиентов можно принимать сразу.
+  bool load_from_log(std::size_t max_lines);
+  bool warming() const { return warming_.load(); }
+  uint64_t warm_ms() const { return warm_ms_.load(); }
+  // Прекратить фоновую догрузку и дождаться задач в пуле; warming() остаётся true,
+  // если кольцо так и не догрузилось.
+  void stop_warmup();
 
-  void append(const Message& m);
+  using PrepareFn = std::function<void(Message&)>;
+  using CommitFn  = std::function<void(const Message&, uint64_t trace)>;
+
+  // Выдаёт m.seq сразу; prepare, шифрование и запись выполняются в пуле (если задан),
+  // а строки попадают в лог строго в порядке seq.
+  void append(Message& m, PrepareFn prepare = nullptr);
+  // Вызывается после записи сообщения в лог и в кольцо, по одному потоку за раз и строго
+  // в порядке seq — рассылка отсюда не обгоняет ни соседние seq, ни since().
+  void set_on_commit(CommitFn fn) { on_commit_ = std::move(fn); }
+  bool append_direct(const DirectMessage& m);
+  // Есть ли личные сообщения: dms.log не реплицируется.
+  bool has_direct() const { return dm_bytes_.load() > 0; }
+  void drain();
 
   std::vector<Message> last(std::size_t n);
+  std::vector<Message> history(uint64_t before_offset, std::size_t limit);
+  // Сообщения с seq в (seq, upto]; false, если их больше max, часть уже недоступна
+  // или до них больше max_scan строк лога вне кольца (0 — столько же, сколько max).
+  // Ещё не записанные seq в ответ не входят: клиенту они придут рассылкой после записи.
+  bool since(uint64_t seq, std::size_t max, std::vector<Message>& out, uint64_t upto = UINT64_MAX,
+             std::size_t max_scan = 0);
+
+  void set_warm_budget(std::size_t bytes) { warm_.set_budget(bytes); }
+  WarmTier& warm() { return warm_; }
+  void set_tracer(Tracer* t) { tracer_ = t; }
+  void set_pool(WorkPool* p) { pool_ = p; }
+  std::size_t inflight();
+  uint64_t ring_bytes() const { return ring_bytes_.load(); }
+  uint64_t avg_message_bytes();
+
+  uint64_t log_offset();
+  uint64_t log_base();
+  std::string log_path() const;
+  std::string compact_path() const;
+  bool read_log(uint64_t from, std::size_t max_bytes, std::string& out);
+  bool wait_log(uint64_t offset, int timeout_ms);
+  bool append_raw(const std::string& chunk, std::vector<Message>& parsed);
+  // Лидер отрезал лог дальше нашего конца: начать локальный лог заново с offset.
+  bool skip_to(uint64_t offset);
+  bool swap_compacted(const std::string& tmp_path, uint64_t cut, uint64_t copied_end);
+
+  bool save_snapshot();
+  bool load_snapshot();
 
   inline void enable_encryption(const std::vector<uint8_t>& key){
     enc_key_ = key;
     enc_enabled_ = (enc_key_.size() == 32);
   }
 
+private:
+  bool decode_line(const std::string& line, Message& m) const;
+  std::string encode_payload(const std::string& text) const;
+  std::string encode_line(const Message& m) const;
+  void write_log(const std::string& data, std::vector<Message> ring_adds);
+  void write_locked(const std::string& data);
+  bool write_direct(const DirectMessage& m);
+
+  struct Pending {
+    Message     m;
+    std::string line;
+    uint64_t    trace = 0;
+  };
+  void complete(Pending p);
+  void commit_batch(std::vector<Pending>& batch);
+  void push_ring(Message m);
+  void push_ring_front(Message m);
+  void warm_fill();
+  void warm_one(std::size_t rank);
+  bool persist_base(uint64_t base, const char* name = "messages.base");
+  void recover_base();
+
 private:
   std::size_t        cap_;
+  UserRegistry&      users_;
   std::string        data_dir_;
   std::ofstream      log_;
-  std::vector<Message> ring_;
+  std::deque<Message> ring_;
+  std::atomic<uint64_t> ring_bytes_{0};
   std::mutex         mx_;
 
+  std::mutex         log_mx_;
+  std::condition_variable log_cv_;
+  uint64_t           log_size_ = 0;
+  uint64_t           log_base_ = 0;
+  uint64_t           log_gen_ = 0;
+  std::size_t        log_readers_ = 0;   // открытые read_log; подмена лога ждёт их
+  bool               log_swapping_ = false;
+  uint64_t           written_seq_ = 1;   // seq, следующий за последним записанным в лог
+
+  std::mutex         commit_mx_;
+  std::condition_variable commit_cv_;
+  std::map<uint64_t, Pending> reorder_;  // готовые строки, ждущие своей очереди
+  uint64_t           next_seq_ = 1;
+  uint64_t           next_commit_ = 1;
+  bool               committing_ = false;
+  WorkPool*          pool_ = nullptr;
+  CommitFn           on_commit_;
+
+  // Фоновая догрузка хвоста лога (load_from_log): строки от новых к старым,
+  // готовые встают в начало кольца строго подряд.
+  std::mutex         load_mx_;
+  std::condition_variable load_cv_;
+  std::vector<std::pair<uint64_t, std::string>> load_lines_;   // offset, строка
+  std::map<std::size_t, std::pair<bool, Message>> load_ready_;
+  std::size_t        load_submitted_ = 0;
+  std::size_t        load_inserted_ = 0;
+  std::size_t        load_running_ = 0;
+  bool               load_abort_ = false;
+  uint64_t           load_t0_ = 0;
+  std::atomic<bool>  warming_{false};
+  std::atomic<uint64_t> warm_ms_{0};
+
+  WarmTier           warm_;
+  Tracer*            tracer_ = nullptr;
+
+  std::mutex         dm_mx_;
+  std::ofstream      dm_log_;
+  std::atomic<uint64_t> dm_bytes_{0};
+
   bool               enc_enabled_ = false;
   std::vector<uint8_t> enc_key_;
 };
@@ -0,0 +1,90 @@
+#include "storage/users.hpp"
+
+#include <filesystem>
+
+namespace lanchat {
+
+static constexpr std::size_t kFlushBatch = 64;
+
+bool UserRegistry::open(const std::string& data_dir){
+  std::filesystem::create_directories(data_dir);
+  const auto p = std::filesystem::path(data_dir) / "users.log";
+  {
+    std::ifstream in(p.string());
+    std::string line;
+    std::unique_lock<std::shared_mutex> lk(mx_);
+    while (std::getline(in, line)){
+      if (!line.empty() && line.back()=='\r') line.pop_back();
+      if (!line.empty()) insert_locked(line);
+    }
+  }
+  std::lock_guard<std::mutex> lk(io_mx_);
+  log_.open(p.string(), std::ios::app);
+  return log_.is_open();
+}
+
+uint32_t UserRegistry::insert_locked(const std::string& name){
+  auto it = ids_.find(name);
+  if (it != ids_.end()) return it->second;
+  const uint32_t id = static_cast<uint32_t>(names_.size());
+  names_.push_back(name);
+  ids_.emplace(name, id);
+  return id;
+}
+
+uint32_t UserRegistry::intern(const std::string& name){
+  {
+    std::shared_lock<std::shared_mutex> lk(mx_);
+    auto it = ids_.find(name);
+    if (it != ids_.end()) return it->second;
+  }
+  uint32_t id;
+  bool batch_full = false;
+  {
+    std::unique_lock<std::shared_mutex> lk(mx_);
+    const std::size_t before = names_.size();
+    id = insert_locked(name);
+    if (names_.size() != before){
+      pending_.push_back(name);
+      batch_full = pending_.size() >= kFlushBatch;
+    }
+  }
+  if (batch_full) flush();
+  return id;
+}
+
+uint32_t UserRegistry::find(const std::string& name) const {
+  std::shared_lock<std::shared_mutex> lk(mx_);
+  auto it = ids_.find(name);
+  return it == ids_.end() ? kNone : it->second;
+}
+
+const std::string& UserRegistry::name(uint32_t id) const {
+  static const std::string unknown = "?";
+  std::shared_lock<std::shared_mutex> lk(mx_);
+  return id < names_.size() ? names_[id] : unknown;
+}
+
+std::vector<std::string> UserRegistry::names() const {
+  std::shared_lock<std::shared_mutex> lk(mx_);
+  return std::vector<std::string>(names_.begin(), names_.end());
+}
+
+std::size_t UserRegistry::size() const {
+  std::shared_lock<std::shared_mutex> lk(mx_);
+  return names_.size();
+}
+
+void UserRegistry::flush(){
+  std::vector<std::string> batch;
+  std::lock_guard<std::mutex> io(io_mx_);
+  {
+    std::unique_lock<std::shared_mutex> lk(mx_);
+    batch.swap(pending_);
+  }
+  if (batch.empty() || !log_.is_open()) return;
+  for (const auto& n : batch) log_ << n << "\n";
+  log_.flush();
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef LANCHAT_STORAGE_USERS_HPP
+#define LANCHAT_STORAGE_USERS_HPP
+
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Реестр пользователей: имя -> компактный числовой ID.
+ * ID выдаются в порядке появления и живут только в памяти процесса
+ * (кольцо и снапшот ссылаются на ID, лог и протокол по-прежнему на имена).
+ * Новые имена дописываются в users.log пачками через flush().
+ */
+class UserRegistry {
+public:
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  bool open(const std::string& data_dir);
+
+  uint32_t intern(const std::string& name);
+  uint32_t find(const std::string& name) const;
+  const std::string& name(uint32_t id) const;
+
+  std::vector<std::string> names() const;
+  std::size_t size() const;
+
+  void flush();
+
+private:
+  uint32_t insert_locked(const std::string& name);
+
+private:
+  mutable std::shared_mutex mx_;
+  std::unordered_map<std::string, uint32_t> ids_;
+  std::deque<std::string> names_;
+  std::vector<std::string> pending_;
+
+  std::mutex io_mx_;
+  std::ofstream log_;
+};
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "storage/warm.hpp"
+#include "storage/storage.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace lanchat {
+
+static constexpr uint32_t kBlockLines = 128;
+
+WarmTier::WarmTier(DecodeFn decode) : decode_(std::move(decode)) {}
+
+WarmTier::~WarmTier() = default;
+
+void WarmTier::set_budget(std::size_t bytes){
+  std::lock_guard<std::mutex> lk(mx_);
+  budget_ = bytes;
+  evict_to(budget_);
+}
+
+void WarmTier::reset(uint64_t gen){
+  std::lock_guard<std::mutex> lk(mx_);
+  gen_ = gen;
+  reset_locked();
+}
+
+void WarmTier::reset_locked(){
+  map_.unmap();
+  blocks_.clear();
+  indexed_end_ = 0;
+  cache_.clear();
+  lru_.clear();
+  cache_bytes_ = 0;
+}
+
+std::size_t WarmTier::cache_bytes(){
+  std::lock_guard<std::mutex> lk(mx_);
+  return cache_bytes_;
+}
+
+std::size_t WarmTier::blocks(){
+  std::lock_guard<std::mutex> lk(mx_);
+  return blocks_.size();
+}
+
+bool WarmTier::extend(const std::string& path, uint64_t phys_end){
+  if (phys_end <= indexed_end_) return true;
+  if (phys_end > map_.size() && !map_.map(path, phys_end)){
+    reset_locked();
+    return false;
+  }
+
+  if (!blocks_.empty() && blocks_.back().lines < kBlockLines){
+    auto it = cache_.find(blocks_.back().begin);
+    if (it != cache_.end()){
+      cache_bytes_ -= it->second.cost;
+      lru_.erase(it->second.lru);
+      cache_.erase(it);
+    }
+    indexed_end_ = blocks_.back().begin;
+    blocks_.pop_back();
+  }
+
+  const char* data = map_.data();
+  uint64_t pos = indexed_end_;
+  Block cur; cur.begin = pos;
+  while (pos < phys_end){
+    const char* line = data + pos;
+    const void* nl = std::memchr(line, '\n', static_cast<size_t>(phys_end - pos));
+    if (!nl) break;
+    const uint64_t next = static_cast<uint64_t>(static_cast<const char*>(nl) - data) + 1;
+    ++cur.lines;
+    cur.end = pos = next;
+    if (cur.lines == kBlockLines){
+      blocks_.push_back(cur);
+      cur = Block{}; cur.begin = pos;
+    }
+  }
+  if (cur.lines) blocks_.push_back(cur);
+  indexed_end_ = pos;
+  return true;
+}
+
+std::shared_ptr<const std::vector<Message>> WarmTier::cached(const Block& b){
+  auto it = cache_.find(b.begin);
+  if (it == cache_.end()){
+    ++misses_;
+    return nullptr;
+  }
+  ++hits_;
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+  return it->second.msgs;
+}
+
+std::shared_ptr<const std::vector<Message>> WarmTier::decode_block(const std::string& raw, uint64_t offset, std::size_t& cost){
+  auto msgs = std::make_shared<std::vector<Message>>();
+  cost = 0;
+  std::size_t pos = 0;
+  while (pos < raw.size()){
+    std::size_t nl = raw.find('\n', pos);
+    if (nl == std::string::npos) nl = raw.size();
+    Message m{};
+    if (decode_(raw.substr(pos, nl - pos), m)){
+      m.offset = offset + pos;
+      cost += sizeof(Message) + m.text.capacity();
+      msgs->push_back(std::move(m));
+    }
+    pos = nl + 1;
+  }
+  return msgs;
+}
+
+void WarmTier::store(std::size_t index, const Block& b, std::shared_ptr<const std::vector<Message>> msgs, std::size_t cost){
+  // Пока блок расшифровывался, его могли дописать (хвостовой блок) или уже положить в кэш.
+  if (index >= blocks_.size() || blocks_[index].begin != b.begin || blocks_[index].end != b.end) return;
+  if (cache_.count(b.begin)) return;
+  lru_.push_front(b.begin);
+  cache_[b.begin] = Cached{std::move(msgs), cost, lru_.begin()};
+  cache_bytes_ += cost;
+  evict_to(budget_);
+}
+
+void WarmTier::evict_to(std::size_t budget){
+  while (cache_bytes_ > budget && !lru_.empty()){
+    auto it = cache_.find(lru_.back());
+    if (it != cache_.end()){
+      cache_bytes_ -= it->second.cost;
+      cache_.erase(it);
+    }
+    lru_.pop_back();
+  }
+}
+
+std::vector<Message> WarmTier::query(const std::string& path, uint64_t gen, uint64_t base, uint64_t phys_end,
+                                     uint64_t before_offset, std::size_t limit){
+  std::vector<Message> out;
+  if (!limit || before_offset <= base) return out;
+  const uint64_t phys_before = std::min(before_offset - base, phys_end);
+
+  std::unique_lock<std::mutex> lk(mx_);
+  if (gen != gen_) return out;
+  if (base != base_){
+    reset_locked();
+    base_ = base;
+  }
+  if (!extend(path, phys_before)) return out;
+
+  // Под mx_ только копируются сырые строки блока; расшифровка идёт без блокировки,
+  // чтобы промах по одному блоку не останавливал остальные запросы.
+  for (std::size_t i = blocks_.size(); i > 0 && out.size() < limit; ){
+    const Block b = blocks_[--i];
+    if (b.begin >= phys_before) continue;
+    auto msgs = cached(b);
+    if (!msgs){
+      const std::string raw(map_.data() + b.begin, static_cast<std::size_t>(b.end - b.begin));
+      lk.unlock();
+      std::size_t cost = 0;
+      msgs = decode_block(raw, base + b.begin, cost);
+      lk.lock();
+      if (gen != gen_ || base != base_) return {};   // лог подменили, пока расшифровывали
+      store(i, b, msgs, cost);
+    }
+    for (auto m = msgs->rbegin(); m != msgs->rend() && out.size() < limit; ++m){
+      if (m->offset < before_offset) out.push_back(*m);
+    }
+  }
+  std::reverse(out.begin(), out.end());
+  return out;
+}
+
+}
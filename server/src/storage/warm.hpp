@@ -0,0 +1,83 @@
+#ifndef LANCHAT_STORAGE_WARM_HPP
+#define LANCHAT_STORAGE_WARM_HPP
+
+#include "util/mapped_file.hpp"
+
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <list>
+
+namespace lanchat {
+
+struct Message;
+
+/**
+ * Тёплый уровень истории: messages.log отображён в память только на чтение,
+ * по нему строится разреженный индекс блоков (по kBlockLines строк),
+ * а декодированные блоки держатся в LRU-кэше в пределах бюджета памяти.
+ * Поколение (gen) меняется при подмене лога компактором: запрос со старым
+ * поколением получает пустой ответ, а не читает чужой файл.
+ */
+class WarmTier {
+public:
+  using DecodeFn = std::function<bool(const std::string&, Message&)>;
+
+  explicit WarmTier(DecodeFn decode);
+  ~WarmTier();
+
+  void set_budget(std::size_t bytes);
+  void reset(uint64_t gen);
+
+  std::vector<Message> query(const std::string& path, uint64_t gen, uint64_t base, uint64_t phys_end,
+                             uint64_t before_offset, std::size_t limit);
+
+  std::size_t cache_bytes();
+  std::size_t blocks();
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+private:
+  struct Block {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint32_t lines = 0;
+  };
+
+  struct Cached {
+    std::shared_ptr<const std::vector<Message>> msgs;
+    std::size_t cost = 0;
+    std::list<uint64_t>::iterator lru;
+  };
+
+  void reset_locked();
+  bool extend(const std::string& path, uint64_t phys_end);
+  std::shared_ptr<const std::vector<Message>> cached(const Block& b);
+  std::shared_ptr<const std::vector<Message>> decode_block(const std::string& raw, uint64_t offset, std::size_t& cost);
+  void store(std::size_t index, const Block& b, std::shared_ptr<const std::vector<Message>> msgs, std::size_t cost);
+  void evict_to(std::size_t budget);
+
+private:
+  DecodeFn decode_;
+  std::mutex mx_;
+  MappedFile map_;
+  uint64_t gen_ = 0;
+  uint64_t base_ = 0;
+  uint64_t indexed_end_ = 0;
+  std::vector<Block> blocks_;
+
+  std::unordered_map<uint64_t, Cached> cache_;
+  std::list<uint64_t> lru_;
+  std::size_t cache_bytes_ = 0;
+  std::size_t budget_ = 16u << 20;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}
+
+#endif
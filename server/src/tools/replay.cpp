@@ -0,0 +1,215 @@
+// lanchat_replay: воспроизводит запись входящего трафика (capture-*.lcap)
+// на локальном сервере в реальном времени, ускоренно или без пауз,
+// и печатает пропускную способность и задержку доставки MSG -> MSG_BROADCAST.
+
+#include "net/capture.hpp"
+#include "net/protocol.hpp"
+#include "util/utils.hpp"
+
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+using namespace lanchat;
+
+namespace {
+
+uint64_t steady_us(){
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct Results {
+  std::mutex mx;
+  std::vector<uint64_t> latency_us;
+  std::atomic<uint64_t> received{0};
+};
+
+struct ReplayConn {
+  socket_t sock = INVALID_SOCK;
+  std::string username;
+  std::mutex mx;
+  std::deque<std::pair<std::string, uint64_t>> pending;   // text -> время отправки
+  std::thread reader;
+};
+
+void reader_loop(std::shared_ptr<ReplayConn> c, Results* res){
+  uint8_t hdr[wire::kHeaderSize];
+  while (read_exact(c->sock, hdr, sizeof(hdr))){
+    const uint32_t len = wire::parse_header(hdr).len;
+    if (len > (1u<<20)) break;
+    std::string payload(len, '\0');
+    if (len && !read_exact(c->sock, payload.data(), len)) break;
+
+    if (hdr[0] == PING){
+      std::lock_guard<std::mutex> lk(c->mx);
+      send_frame(c->sock, PONG, "");
+      continue;
+    }
+    if (hdr[0] != MSG_BROADCAST) continue;
+    ++res->received;
+
+    BroadcastFrame::View msg;
+    if (!BroadcastFrame::decode(payload, msg) || std::get<1>(msg) != c->username) continue;
+    const std::string_view text = std::get<2>(msg);
+    uint64_t sent = 0;
+    {
+      std::lock_guard<std::mutex> lk(c->mx);
+      auto it = std::find_if(c->pending.begin(), c->pending.end(),
+                             [&](const std::pair<std::string, uint64_t>& p){ return p.first == text; });
+      if (it == c->pending.end()) continue;
+      sent = it->second;
+      c->pending.erase(it);
+    }
+    std::lock_guard<std::mutex> lk(res->mx);
+    res->latency_us.push_back(steady_us() - sent);
+  }
+}
+
+void close_conn(ReplayConn& c){
+  if (c.sock == INVALID_SOCK) return;
+  shutdown(c.sock, SHUT_RDWR);
+  if (c.reader.joinable()) c.reader.join();
+  CLOSESOCK(c.sock);
+  c.sock = INVALID_SOCK;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& v, double p){
+  if (v.empty()) return 0;
+  size_t i = static_cast<size_t>(p * static_cast<double>(v.size() - 1) + 0.5);
+  return v[std::min(i, v.size() - 1)];
+}
+
+void usage(const char* argv0){
+  std::cout << "Usage: " << argv0
+            << " --capture FILE [--host 127.0.0.1] [--port 5555] [--speed 1|10|0 (max)]\n";
+}
+
+}
+
+int main(int argc, char** argv){
+  std::string path, host = "127.0.0.1";
+  uint16_t port = 5555;
+  double speed = 1.0;
+  for (int i = 1; i < argc; ++i){
+    std::string a = argv[i];
+    auto next = [&]()->std::string{
+      if (i+1 >= argc){ usage(argv[0]); std::exit(1); }
+      return argv[++i];
+    };
+    if      (a == "--capture") path = next();
+    else if (a == "--host")    host = next();
+    else if (a == "--port")    port = static_cast<uint16_t>(std::stoi(next()));
+    else if (a == "--speed")   speed = std::stod(next());
+    else { usage(argv[0]); return a == "-h" || a == "--help" ? 0 : 1; }
+  }
+  if (path.empty()){ usage(argv[0]); return 1; }
+
+#ifdef _WIN32
+  WSADATA wsa; if (WSAStartup(MAKEWORD(2,2), &wsa)!=0) return 1;
+#endif
+
+  CaptureReader reader;
+  if (!reader.open(path)){
+    std::cerr << "Cannot read capture " << path << "\n";
+    return 1;
+  }
+
+  Results res;
+  std::unordered_map<uint32_t, std::shared_ptr<ReplayConn>> conns;
+  uint64_t frames = 0, messages = 0, connects = 0, failures = 0, max_lag_us = 0;
+  const uint64_t t0 = steady_us();
+
+  CaptureRecord rec;
+  while (reader.next(rec)){
+    if (speed > 0){
+      const uint64_t due = t0 + static_cast<uint64_t>(static_cast<double>(rec.t_us) / speed);
+      const uint64_t now = steady_us();
+      if (due > now) std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+      else max_lag_us = std::max(max_lag_us, now - due);
+    }
+
+    if (rec.type == HELLO){
+      HelloInfo hello;
+      parse_hello(rec.payload, hello);
+      auto c = std::make_shared<ReplayConn>();
+      c->username = hello.username;
+      c->sock = connect_tcp(host, port);
+      if (c->sock == INVALID_SOCK || !send_frame(c->sock, HELLO, hello.username)){
+        ++failures;
+        continue;
+      }
+      c->reader = std::thread(reader_loop, c, &res);
+      conns[rec.conn] = c;
+      ++connects;
+      continue;
+    }
+
+    auto it = conns.find(rec.conn);
+    if (it == conns.end()) continue;
+    auto& c = it->second;
+    if (rec.type == kCaptureClose){
+      close_conn(*c);
+      conns.erase(it);
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lk(c->mx);
+    if (rec.type == MSG){
+      c->pending.emplace_back(rec.payload, steady_us());
+      ++messages;
+    }
+    if (!send_frame(c->sock, rec.type, rec.payload)) ++failures;
+    ++frames;
+  }
+  const uint64_t sent_us = steady_us() - t0;
+
+  // Ждём доставки отправленных сообщений, но не дольше 5 секунд.
+  const uint64_t deadline = steady_us() + 5000000;
+  while (steady_us() < deadline){
+    bool idle = true;
+    for (auto& kv : conns){
+      std::lock_guard<std::mutex> lk(kv.second->mx);
+      if (!kv.second->pending.empty()){ idle = false; break; }
+    }
+    if (idle) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  const uint64_t total_us = steady_us() - t0;
+  for (auto& kv : conns) close_conn(*kv.second);
+
+  std::vector<uint64_t> lat;
+  {
+    std::lock_guard<std::mutex> lk(res.mx);
+    lat = res.latency_us;
+  }
+  std::sort(lat.begin(), lat.end());
+  const double secs = static_cast<double>(sent_us) / 1e6;
+  auto ms = [](uint64_t us){ return static_cast<double>(us) / 1000.0; };
+
+  std::cout << "capture:     " << path << " (recorded at " << reader.start_ms() << ")\n"
+            << "speed:       " << (speed > 0 ? std::to_string(speed) + "x" : std::string("max")) << "\n"
+            << "connections: " << connects << " (failures " << failures << ")\n"
+            << "frames:      " << frames << " in " << secs << " s"
+            << " (" << (secs > 0 ? static_cast<double>(frames) / secs : 0.0) << " frames/s)\n"
+            << "messages:    " << messages << " sent, " << lat.size() << " echoed, "
+            << res.received.load() << " broadcasts received in " << ms(total_us) / 1000.0 << " s\n"
+            << "latency ms:  p50=" << ms(percentile(lat, 0.50))
+            << " p90=" << ms(percentile(lat, 0.90))
+            << " p99=" << ms(percentile(lat, 0.99))
+            << " max=" << ms(lat.empty() ? 0 : lat.back()) << "\n"
+            << "sched lag:   max " << ms(max_lag_us) << " ms\n";
+
+#ifdef _WIN32
+  WSACleanup();
+#endif
+  return 0;
+}
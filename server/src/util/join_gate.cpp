@@ -0,0 +1,75 @@
+#include "util/join_gate.hpp"
+#include "util/utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace lanchat {
+
+void JoinGate::configure(double rate, std::size_t burst, std::size_t queue_max, uint64_t wait_ms){
+  std::lock_guard<std::mutex> lk(mx_);
+  rate_ = rate;
+  burst_ = static_cast<double>(std::max<std::size_t>(burst, 1));
+  // Больше, чем пройдёт за wait_ms, ставить в очередь бессмысленно: такой вход всё равно
+  // получит BUSY, только позже и заняв поток на всё ожидание.
+  const auto drain = static_cast<std::size_t>(burst_ + rate_ * static_cast<double>(wait_ms) / 1000);
+  queue_max_ = queue_max ? std::min(queue_max, drain) : drain;
+  tokens_ = burst_;
+  last_us_ = mono_us();
+}
+
+void JoinGate::refill(uint64_t now_us){
+  tokens_ = std::min(burst_, tokens_ + static_cast<double>(now_us - last_us_) * rate_ / 1e6);
+  last_us_ = now_us;
+}
+
+bool JoinGate::enter(){
+  std::size_t cur = queued_.load();
+  do {
+    if (queue_max_ && cur >= queue_max_) return false;
+  } while (!queued_.compare_exchange_weak(cur, cur + 1));
+  return true;
+}
+
+void JoinGate::leave(){
+  --queued_;
+}
+
+bool JoinGate::admit(uint64_t wait_ms, const std::atomic<bool>& stop){
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_ms);
+  std::unique_lock<std::mutex> lk(mx_);
+  const auto me = waiters_.emplace(waiters_.end());
+  bool ok = false;
+  for (;;){
+    if (stop.load()) break;
+    refill(mono_us());
+    if (waiters_.begin() == me && tokens_ >= 1){
+      tokens_ -= 1;
+      ok = true;
+      break;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) break;
+    // Первый в очереди спит до следующего токена, остальные — до смены первого.
+    auto until = deadline;
+    if (waiters_.begin() == me){
+      const auto next = std::chrono::microseconds(static_cast<int64_t>((1 - tokens_) * 1e6 / rate_) + 1);
+      until = std::min(until, std::chrono::steady_clock::now() + next);
+    }
+    me->cv.wait_until(lk, until);
+  }
+  // Ждать токена может только первый: если ушёл он, будим нового первого.
+  const bool was_head = waiters_.begin() == me;
+  waiters_.erase(me);
+  if (was_head && !waiters_.empty()) waiters_.front().cv.notify_one();
+  lk.unlock();
+  leave();
+  return ok;
+}
+
+uint32_t JoinGate::retry_after_ms() const {
+  if (!enabled()) return 0;
+  const double ms = (static_cast<double>(queued_.load()) + 1) * 1000 / rate_;
+  return static_cast<uint32_t>(std::min(ms, 60000.0)) + 100;
+}
+
+}
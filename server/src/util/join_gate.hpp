@@ -0,0 +1,61 @@
+#ifndef LANCHAT_UTIL_JOIN_GATE_HPP
+#define LANCHAT_UTIL_JOIN_GATE_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <list>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Допуск новых клиентов при лавине переподключений: корзина токенов
+ * (rate входов в секунду, запас burst) и ограниченная очередь рукопожатий.
+ * Место в очереди берётся сразу при accept (enter), токены выдаются строго
+ * в порядке прихода (admit), так что никто не обгоняет ждущих дольше.
+ * Очередь не длиннее того, что успеет пройти за wait_ms (burst + rate * wait),
+ * поэтому лишние получают BUSY ещё при accept, без потока на рукопожатие.
+ * Кто всё же не дождался за wait_ms, получает BUSY с оценкой retry_after_ms().
+ * Выключено по умолчанию (rate 0).
+ */
+class JoinGate {
+public:
+  void configure(double rate, std::size_t burst, std::size_t queue_max, uint64_t wait_ms);
+  bool enabled() const { return rate_ > 0; }
+
+  // Занять место в очереди; false — очередь полна (см. configure).
+  bool enter();
+  // Освободить место без входа (рукопожатие сорвалось или это не клиент).
+  void leave();
+  // Дождаться своей очереди и токена; место освобождается в любом случае.
+  bool admit(uint64_t wait_ms, const std::atomic<bool>& stop);
+
+  // Через сколько стоит повторить попытку, чтобы очередь успела разойтись.
+  uint32_t retry_after_ms() const;
+  std::size_t queued() const { return queued_.load(); }
+
+private:
+  void refill(uint64_t now_us);
+
+  struct Waiter {
+    std::condition_variable cv;
+  };
+
+  double      rate_ = 0;
+  double      burst_ = 1;
+  std::size_t queue_max_ = 0;        // 0 — без ограничения
+
+  std::mutex  mx_;
+  double      tokens_ = 0;
+  uint64_t    last_us_ = 0;
+  // В порядке прихода; токен получает первый. У каждого своя cv: уход первого
+  // будит только следующего, а не всю очередь.
+  std::list<Waiter> waiters_;
+  std::atomic<std::size_t> queued_{0};
+};
+
+}
+
+#endif
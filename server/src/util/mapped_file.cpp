@@ -0,0 +1,60 @@
+#include "util/mapped_file.hpp"
+
+#ifdef _WIN32
+  #define NOMINMAX
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+namespace lanchat {
+
+MappedFile::~MappedFile(){ unmap(); }
+
+bool MappedFile::map(const std::string& path, uint64_t length){
+  unmap();
+  if (length == 0) return false;
+#ifdef _WIN32
+  HANDLE f = CreateFileA(path.c_str(), GENERIC_READ,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (f == INVALID_HANDLE_VALUE) return false;
+  HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY,
+                                static_cast<DWORD>(length >> 32),
+                                static_cast<DWORD>(length & 0xFFFFFFFFULL), nullptr);
+  if (!m){ CloseHandle(f); return false; }
+  void* p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(length));
+  if (!p){ CloseHandle(m); CloseHandle(f); return false; }
+  file_ = f;
+  mapping_ = m;
+  data_ = static_cast<const char*>(p);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  void* p = ::mmap(nullptr, static_cast<size_t>(length), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) return false;
+  data_ = static_cast<const char*>(p);
+#endif
+  size_ = length;
+  return true;
+}
+
+void MappedFile::unmap(){
+  if (!data_) return;
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(static_cast<HANDLE>(mapping_));
+  CloseHandle(static_cast<HANDLE>(file_));
+  mapping_ = file_ = nullptr;
+#else
+  ::munmap(const_cast<char*>(data_), static_cast<size_t>(size_));
+#endif
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}
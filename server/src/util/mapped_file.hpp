@@ -0,0 +1,38 @@
+#ifndef LANCHAT_UTIL_MAPPED_FILE_HPP
+#define LANCHAT_UTIL_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace lanchat {
+
+/**
+ * Отображение файла в память только на чтение (mmap / MapViewOfFile).
+ * Файл открывается с разделением записи и удаления, чтобы не мешать логу.
+ */
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool map(const std::string& path, uint64_t length);
+  void unmap();
+
+  const char* data() const { return data_; }
+  uint64_t size() const { return size_; }
+
+private:
+  const char* data_ = nullptr;
+  uint64_t    size_ = 0;
+#ifdef _WIN32
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#endif
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef LANCHAT_UTIL_MEM_BUDGET_HPP
+#define LANCHAT_UTIL_MEM_BUDGET_HPP
+
+#include <cstdint>
+#include <atomic>
+
+namespace lanchat {
+
+/**
+ * Учёт памяти сервера по категориям с общим лимитом.
+ * Буферы приёма и отправки берут память через try_charge() и получают отказ,
+ * если лимит исчерпан; кэши хранилища ограничены своими настройками
+ * и отражаются здесь через set(), уменьшая запас для остальных.
+ */
+class MemBudget {
+public:
+  enum Kind { kRx, kTx, kRing, kWarm, kKinds };
+
+  void set_limit(uint64_t bytes) { limit_ = bytes; }
+  uint64_t limit() const { return limit_.load(); }
+
+  bool try_charge(Kind k, uint64_t n){
+    uint64_t cur = total_.load();
+    do {
+      if (cur + n > limit_.load()) return false;
+    } while (!total_.compare_exchange_weak(cur, cur + n));
+    used_[k] += n;
+    return true;
+  }
+
+  void release(Kind k, uint64_t n){
+    used_[k] -= n;
+    total_ -= n;
+  }
+
+  void set(Kind k, uint64_t n){
+    const uint64_t old = used_[k].exchange(n);
+    total_ += n - old;
+  }
+
+  uint64_t used(Kind k) const { return used_[k].load(); }
+  uint64_t total() const { return total_.load(); }
+
+private:
+  std::atomic<uint64_t> limit_{UINT64_MAX};
+  std::atomic<uint64_t> total_{0};
+  std::atomic<uint64_t> used_[kKinds] = {};
+};
+
+/** Захваченная часть бюджета: возвращается в общий и per-connection счётчик в деструкторе. */
+class MemLease {
+public:
+  MemLease() = default;
+  MemLease(MemBudget* b, MemBudget::Kind k, std::atomic<uint64_t>* conn, uint64_t n)
+    : b_(b), k_(k), conn_(conn), n_(n) {}
+  ~MemLease(){ reset(); }
+  MemLease(const MemLease&) = delete;
+  MemLease& operator=(const MemLease&) = delete;
+  MemLease& operator=(MemLease&& o) noexcept {
+    if (this != &o){
+      reset();
+      b_ = o.b_; k_ = o.k_; conn_ = o.conn_; n_ = o.n_;
+      o.n_ = 0;
+    }
+    return *this;
+  }
+
+  // Присоединить аренду того же бюджета и подключения (outq растёт по кадру).
+  void absorb(MemLease&& o){
+    if (!n_){ *this = std::move(o); return; }
+    n_ += o.n_;
+    o.n_ = 0;
+  }
+
+  void reset(){
+    if (!n_) return;
+    b_->release(k_, n_);
+    if (conn_) *conn_ -= n_;
+    n_ = 0;
+  }
+
+private:
+  MemBudget* b_ = nullptr;
+  MemBudget::Kind k_ = MemBudget::kRx;
+  std::atomic<uint64_t>* conn_ = nullptr;
+  uint64_t n_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include "util/timer_wheel.hpp"
+
+#include <chrono>
+#include <vector>
+
+namespace lanchat {
+
+TimerWheel::TimerWheel(uint32_t tick_ms) : tick_ms_(tick_ms ? tick_ms : 1) {}
+
+TimerWheel::~TimerWheel(){
+  stop();
+  for (auto& kv : nodes_) delete kv.second;
+}
+
+void TimerWheel::start(){
+  std::lock_guard<std::mutex> lk(mx_);
+  if (th_.joinable()) return;
+  stop_ = false;
+  th_ = std::thread([this]{ run(); });
+}
+
+void TimerWheel::stop(){
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (th_.joinable() && th_.get_id() != std::this_thread::get_id()) th_.join();
+}
+
+void TimerWheel::link(Node* n){
+  const uint64_t max_delta = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+  if (n->expires < now_tick_) n->expires = now_tick_;
+  if (n->expires - now_tick_ > max_delta) n->expires = now_tick_ + max_delta;
+
+  const uint64_t delta = n->expires - now_tick_;
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (uint64_t(1) << (kSlotBits * (level + 1)))) ++level;
+  const int slot = static_cast<int>((n->expires >> (kSlotBits * level)) & (kSlots - 1));
+
+  Node*& head = slots_[level][slot];
+  n->head = &head;
+  n->prev = nullptr;
+  n->next = head;
+  if (head) head->prev = n;
+  head = n;
+}
+
+void TimerWheel::unlink(Node* n){
+  if (n->prev) n->prev->next = n->next;
+  else if (n->head) *n->head = n->next;
+  if (n->next) n->next->prev = n->prev;
+  n->head = nullptr;
+  n->prev = n->next = nullptr;
+}
+
+TimerWheel::TimerId TimerWheel::schedule(uint32_t delay_ms, Callback cb){
+  Node* n = new Node;
+  n->cb = std::move(cb);
+  std::lock_guard<std::mutex> lk(mx_);
+  n->id = next_id_++;
+  const uint64_t ticks = (static_cast<uint64_t>(delay_ms) + tick_ms_ - 1) / tick_ms_;
+  n->expires = now_tick_ + (ticks ? ticks : 1);
+  link(n);
+  nodes_.emplace(n->id, n);
+  return n->id;
+}
+
+bool TimerWheel::cancel(TimerId id){
+  Node* n = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(mx_);
+    auto it = nodes_.find(id);
+    if (it == nodes_.end()) return false;
+    n = it->second;
+    nodes_.erase(it);
+    unlink(n);
+  }
+  delete n;
+  return true;
+}
+
+std::size_t TimerWheel::size(){
+  std::lock_guard<std::mutex> lk(mx_);
+  return nodes_.size();
+}
+
+void TimerWheel::cascade(int level){
+  const int slot = static_cast<int>((now_tick_ >> (kSlotBits * level)) & (kSlots - 1));
+  Node* n = slots_[level][slot];
+  slots_[level][slot] = nullptr;
+  while (n){
+    Node* next = n->next;
+    link(n);
+    n = next;
+  }
+}
+
+void TimerWheel::run(){
+  auto next = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lk(mx_);
+  while (!stop_){
+    next += std::chrono::milliseconds(tick_ms_);
+    cv_.wait_until(lk, next, [&]{ return stop_; });
+    if (stop_) break;
+
+    ++now_tick_;
+    for (int level = 1; level < kLevels; ++level){
+      if (now_tick_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) break;
+      cascade(level);
+    }
+
+    std::vector<Node*> due;
+    const int slot = static_cast<int>(now_tick_ & (kSlots - 1));
+    for (Node* n = slots_[0][slot]; n; ){
+      Node* nx = n->next;
+      if (n->expires <= now_tick_){
+        unlink(n);
+        nodes_.erase(n->id);
+        due.push_back(n);
+      }
+      n = nx;
+    }
+
+    lk.unlock();
+    for (Node* n : due){
+      if (n->cb) n->cb();
+      delete n;
+    }
+    lk.lock();
+  }
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef LANCHAT_UTIL_TIMER_WHEEL_HPP
+#define LANCHAT_UTIL_TIMER_WHEEL_HPP
+
+#include <condition_variable>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Иерархическое колесо таймеров: 4 уровня по 64 слота, один поток на всё.
+ * schedule()/cancel() — O(1); колбэки выполняются в потоке колеса вне блокировки,
+ * поэтому должны быть короткими.
+ */
+class TimerWheel {
+public:
+  using Callback = std::function<void()>;
+  using TimerId  = uint64_t;
+
+  explicit TimerWheel(uint32_t tick_ms = 100);
+  ~TimerWheel();
+
+  void start();
+  void stop();
+
+  TimerId schedule(uint32_t delay_ms, Callback cb);
+  bool cancel(TimerId id);
+  std::size_t size();
+
+private:
+  static constexpr int kLevels   = 4;
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots    = 1 << kSlotBits;
+
+  struct Node {
+    TimerId  id = 0;
+    uint64_t expires = 0;
+    Callback cb;
+    Node**   head = nullptr;
+    Node*    prev = nullptr;
+    Node*    next = nullptr;
+  };
+
+  void link(Node* n);
+  void unlink(Node* n);
+  void cascade(int level);
+  void run();
+
+private:
+  const uint32_t tick_ms_;
+  std::mutex mx_;
+  std::condition_variable cv_;
+  std::thread th_;
+  bool stop_ = false;
+
+  uint64_t now_tick_ = 0;
+  TimerId  next_id_ = 1;
+  Node*    slots_[kLevels][kSlots] = {};
+  std::unordered_map<TimerId, Node*> nodes_;
+};
+
+}
+
+#endif
@@ -19,7 +19,10 @@
   #include <sys/socket.h>
   #include <netinet/in.h>
   #include <arpa/inet.h>
+  #include <netdb.h>
   #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/time.h>
   using socket_t = int;
   #define CLOSESOCK ::close
   #define GET_LAST_SOCK_ERR errno
@@ -27,6 +30,14 @@
   #define SOCK_ERROR (-1)
 #endif
 
+#ifdef _WIN32
+  #define SHUT_RDWR SD_BOTH
+#endif
+
+#ifndef MSG_NOSIGNAL
+  #define MSG_NOSIGNAL 0
+#endif
+
 namespace lanchat {
 
 inline uint16_t to_be16(uint16_t v){ return htons(v); }
@@ -124,6 +135,12 @@ inline uint64_t now_ms(){
     std::chrono::system_clock::now().time_since_epoch()).count();
 }
 
+// Монотонное время для коротких интервалов (окна склейки и т.п.).
+inline uint64_t mono_us(){
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
 inline bool read_exact(socket_t s, void* buf, size_t n){
   char* p = static_cast<char*>(buf);
   size_t got=0;
@@ -140,13 +157,57 @@ inline bool write_exact(socket_t s, const void* buf, size_t n){
   const char* p = static_cast<const char*>(buf);
   size_t sent=0;
   while(sent<n){
-    int r = send(s, p+sent, static_cast<int>(n-sent), 0);
+    int r = send(s, p+sent, static_cast<int>(n-sent), MSG_NOSIGNAL);
     if (r==SOCK_ERROR) return false;
     sent += static_cast<size_t>(r);
   }
   return true;
 }
 
+// Сколько байт уже лежит в приёмном буфере сокета; не ждёт.
+inline std::size_t readable_bytes(socket_t s){
+#ifdef _WIN32
+  u_long n = 0;
+  return ioctlsocket(s, FIONREAD, &n) == SOCK_ERROR ? 0 : static_cast<std::size_t>(n);
+#else
+  int n = 0;
+  return ioctl(s, FIONREAD, &n) < 0 ? 0 : static_cast<std::size_t>(n);
+#endif
+}
+
+// read_exact вернёт false, если за ms не пришло ни байта (0 — ждать без ограничения).
+inline void set_recv_timeout(socket_t s, uint32_t ms){
+#ifdef _WIN32
+  DWORD v = ms;
+#else
+  timeval v{ static_cast<time_t>(ms / 1000), static_cast<suseconds_t>((ms % 1000) * 1000) };
+#endif
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline bool split_host_port(const std::string& hp, std::string& host, uint16_t& port){
+  size_t c = hp.rfind(':');
+  if (c==std::string::npos || c==0 || c+1>=hp.size()) return false;
+  host = hp.substr(0, c);
+  try { port = static_cast<uint16_t>(std::stoi(hp.substr(c+1))); }
+  catch (...) { return false; }
+  return port != 0;
+}
+
+inline socket_t connect_tcp(const std::string& host, uint16_t port){
+  addrinfo hints{}; hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  const std::string ps = std::to_string(port);
+  if (getaddrinfo(host.c_str(), ps.c_str(), &hints, &res) != 0 || !res) return INVALID_SOCK;
+  socket_t s = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (s != INVALID_SOCK && connect(s, res->ai_addr, static_cast<int>(res->ai_addrlen)) == SOCK_ERROR){
+    CLOSESOCK(s);
+    s = INVALID_SOCK;
+  }
+  freeaddrinfo(res);
+  return s;
+}
+
 }
 
 #endif
@@ -0,0 +1,105 @@
+#include "util/work_pool.hpp"
+
+namespace lanchat {
+
+static thread_local const WorkPool* t_pool = nullptr;
+static thread_local std::size_t     t_index = 0;
+
+WorkPool::WorkPool(std::size_t threads){
+  if (!threads) threads = std::thread::hardware_concurrency();
+  if (!threads) threads = 2;
+  for (std::size_t i = 0; i < threads; ++i) queues_.push_back(std::make_unique<Queue>());
+}
+
+WorkPool::~WorkPool(){ stop(); }
+
+void WorkPool::start(){
+  if (running_.exchange(true)) return;
+  for (std::size_t i = 0; i < queues_.size(); ++i) threads_.emplace_back([this, i]{ worker(i); });
+}
+
+void WorkPool::stop(){
+  {
+    std::lock_guard<std::mutex> lk(idle_mx_);
+    if (!running_.exchange(false)) return;
+  }
+  idle_cv_.notify_all();
+  for (auto& t : threads_) if (t.joinable()) t.join();
+  threads_.clear();
+  // Потоки выходят, только когда pending_ == 0, так что здесь обычно пусто;
+  // но задача, оставшаяся в очереди, значит чей-то complete(), которого ждёт drain().
+  for (auto& q : queues_){
+    for (;;){
+      Task task;
+      {
+        std::lock_guard<std::mutex> lk(q->mx);
+        if (q->q.empty()) break;
+        task = std::move(q->q.front());
+        q->q.pop_front();
+      }
+      --pending_;
+      task();
+    }
+  }
+}
+
+void WorkPool::submit(Task task){
+  const std::size_t i = (t_pool == this) ? t_index : next_.fetch_add(1) % queues_.size();
+  {
+    // running_ проверяется под тем же idle_mx_, что и в stop(): иначе задача,
+    // поставленная между проверкой и остановкой, осталась бы в очереди после
+    // выхода потоков, и Storage::drain() ждал бы её вечно.
+    std::unique_lock<std::mutex> lk(idle_mx_);
+    if (!running_.load()){
+      lk.unlock();
+      task();
+      return;
+    }
+    ++pending_;
+    std::lock_guard<std::mutex> qlk(queues_[i]->mx);
+    queues_[i]->q.push_back(std::move(task));
+  }
+  idle_cv_.notify_one();
+}
+
+bool WorkPool::take(std::size_t index, Task& task){
+  {
+    Queue& own = *queues_[index];
+    std::lock_guard<std::mutex> lk(own.mx);
+    if (!own.q.empty()){
+      task = std::move(own.q.front());
+      own.q.pop_front();
+      return true;
+    }
+  }
+  for (std::size_t k = 1; k < queues_.size(); ++k){
+    Queue& victim = *queues_[(index + k) % queues_.size()];
+    std::lock_guard<std::mutex> lk(victim.mx);
+    if (!victim.q.empty()){
+      task = std::move(victim.q.back());
+      victim.q.pop_back();
+      ++steals_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkPool::worker(std::size_t index){
+  t_pool = this;
+  t_index = index;
+  for (;;){
+    Task task;
+    if (take(index, task)){
+      --pending_;
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(idle_mx_);
+    // После остановки пул дорабатывает уже поставленные задачи.
+    if (!running_.load() && pending_.load() == 0) break;
+    idle_cv_.wait(lk, [&]{ return pending_.load() > 0 || !running_.load(); });
+  }
+}
+
+}
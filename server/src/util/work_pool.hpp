@@ -0,0 +1,63 @@
+#ifndef LANCHAT_UTIL_WORK_POOL_HPP
+#define LANCHAT_UTIL_WORK_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace lanchat {
+
+/**
+ * Пул потоков для CPU-задач (хэширование, шифрование) с перехватом работы:
+ * у каждого потока своя очередь, внешние submit() раскладываются по кругу,
+ * задачи из потоков пула кладутся в свою очередь. Свободный поток сначала
+ * берёт работу из своей очереди (с головы), затем крадёт с хвоста чужих.
+ * Порядок выполнения не гарантируется — его восстанавливает вызывающий код.
+ */
+class WorkPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit WorkPool(std::size_t threads = 0);
+  ~WorkPool();
+
+  void start();
+  void stop();
+  bool running() const { return running_.load(); }
+
+  void submit(Task task);
+
+  std::size_t threads() const { return queues_.size(); }
+  uint64_t steals() const { return steals_.load(); }
+  std::size_t pending() const { return pending_.load(); }
+
+private:
+  struct Queue {
+    std::mutex mx;
+    std::deque<Task> q;
+  };
+
+  void worker(std::size_t index);
+  bool take(std::size_t index, Task& task);
+
+private:
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> running_{false};
+  std::atomic<std::size_t> next_{0};
+  std::atomic<std::size_t> pending_{0};
+  std::atomic<uint64_t> steals_{0};
+
+  std::mutex idle_mx_;
+  std::condition_variable idle_cv_;
+};
+
+}
+
+#endif
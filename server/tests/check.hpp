@@ -0,0 +1,70 @@
+#ifndef LANCHAT_TESTS_CHECK_HPP
+#define LANCHAT_TESTS_CHECK_HPP
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace lanchat::test {
+
+/*
+ * Минимальный раннер без внешних зависимостей: TEST(name) регистрирует
+ * функцию, CHECK отмечает провал и продолжает тест, REQUIRE — прерывает его.
+ */
+struct Case {
+  const char* name;
+  void (*fn)();
+};
+
+inline std::vector<Case>& cases(){
+  static std::vector<Case> v;
+  return v;
+}
+
+inline int& failures(){
+  static int n = 0;
+  return n;
+}
+
+struct Register {
+  Register(const char* name, void (*fn)()){ cases().push_back({name, fn}); }
+};
+
+// Пустой временный каталог для теста; удаляется вместе с объектом.
+struct TempDir {
+  std::filesystem::path path;
+  explicit TempDir(const std::string& name)
+    : path(std::filesystem::temp_directory_path() / ("lanchat_test_" + name)) {
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+  }
+  ~TempDir(){ std::error_code ec; std::filesystem::remove_all(path, ec); }
+  std::string str() const { return path.string(); }
+};
+
+}
+
+#define TEST(name)                                                        \
+  static void name();                                                     \
+  static const ::lanchat::test::Register name##_register(#name, &name);   \
+  static void name()
+
+#define CHECK(cond)                                                                  \
+  do {                                                                               \
+    if (!(cond)){                                                                    \
+      ++::lanchat::test::failures();                                                 \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n";     \
+    }                                                                                \
+  } while (0)
+
+#define REQUIRE(cond)                                                                \
+  do {                                                                               \
+    if (!(cond)){                                                                    \
+      ++::lanchat::test::failures();                                                 \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": REQUIRE(" #cond ") failed\n";   \
+      return;                                                                        \
+    }                                                                                \
+  } while (0)
+
+#endif
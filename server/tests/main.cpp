@@ -0,0 +1,18 @@
+#include "check.hpp"
+
+#include <cstring>
+
+// lanchat_tests [фильтр] — запускает тесты, в имени которых есть фильтр.
+int main(int argc, char** argv){
+  using namespace lanchat::test;
+  int run = 0;
+  for (const auto& c : cases()){
+    if (argc > 1 && !std::strstr(c.name, argv[1])) continue;
+    const int before = failures();
+    c.fn();
+    ++run;
+    std::cout << (failures() == before ? "ok   " : "FAIL ") << c.name << "\n";
+  }
+  std::cout << run << " tests, " << failures() << " failed checks\n";
+  return failures() ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#include "check.hpp"
+#include "hash/hash.hpp"
+#include "storage/blobs.hpp"
+
+#include <string>
+
+using namespace lanchat;
+
+static std::string blob(std::size_t n, char seed){
+  std::string s(n, '\0');
+  for (std::size_t i = 0; i < n; ++i) s[i] = static_cast<char>(seed + i * 13);
+  return s;
+}
+
+static std::string id_of(const std::string& s){
+  Sha256 h;
+  h.update(s.data(), s.size());
+  return h.hex_final();
+}
+
+TEST(blobs_begin_reserves_quota){
+  test::TempDir dir("blobs_quota");
+  BlobStore store;
+  REQUIRE(store.open(dir.str(), /*max_blob*/4096, /*quota*/1000));
+  const std::string a = blob(600, 'a'), b = blob(600, 'b');
+  uint64_t have = 1;
+  CHECK(store.begin(id_of(a), a.size(), have) == BlobStore::Put::kPartial);
+  CHECK(have == 0);
+  CHECK(store.used() == 600);
+  // Вторая загрузка не помещается вместе с зарезервированной первой.
+  CHECK(store.begin(id_of(b), b.size(), have) == BlobStore::Put::kQuota);
+  CHECK(store.put(id_of(b), b.size(), 0, b) == BlobStore::Put::kQuota);
+
+  CHECK(store.put(id_of(a), a.size(), 0, std::string_view(a).substr(0, 250)) == BlobStore::Put::kPartial);
+  CHECK(store.have(id_of(a), a.size()) == 250);
+  CHECK(store.put(id_of(a), a.size(), 100, "x") == BlobStore::Put::kBadOffset);
+  CHECK(store.put(id_of(a), a.size(), 250, std::string_view(a).substr(250)) == BlobStore::Put::kComplete);
+  CHECK(store.used() == 600);
+  CHECK(store.stored() == 1);
+  uint64_t size = 0;
+  CHECK(store.stat(id_of(a), size) && size == 600);
+
+  // Повторная загрузка того же содержимого — сразу готово.
+  CHECK(store.begin(id_of(a), a.size(), have) == BlobStore::Put::kComplete);
+  CHECK(have == 600);
+}
+
+TEST(blobs_mismatch_and_sweep_release_quota){
+  test::TempDir dir("blobs_release");
+  BlobStore store;
+  REQUIRE(store.open(dir.str(), 4096, 1000));
+  const std::string a = blob(300, 'c');
+  const std::string wrong_id = id_of("something else");
+  CHECK(store.put(wrong_id, a.size(), 0, a) == BlobStore::Put::kMismatch);
+  CHECK(store.used() == 0);
+
+  uint64_t have = 0;
+  CHECK(store.begin(id_of(a), a.size(), have) == BlobStore::Put::kPartial);
+  CHECK(store.put(id_of(a), a.size(), 0, std::string_view(a).substr(0, 100)) == BlobStore::Put::kPartial);
+  CHECK(store.used() == 300);
+  CHECK(store.sweep_partial(0) == 1);
+  CHECK(store.used() == 0);
+  CHECK(store.have(id_of(a), a.size()) == 0);
+}
+
+// Загрузка, прерванная перезапуском: хэш догоняется по уже записанному файлу.
+TEST(blobs_resume_after_reopen){
+  test::TempDir dir("blobs_resume");
+  const std::string a = blob(3000, 'd');
+  {
+    BlobStore store;
+    REQUIRE(store.open(dir.str(), 4096, 0));
+    CHECK(store.put(id_of(a), a.size(), 0, std::string_view(a).substr(0, 1234)) == BlobStore::Put::kPartial);
+  }
+  BlobStore store;
+  REQUIRE(store.open(dir.str(), 4096, 0));
+  CHECK(store.used() == 1234);
+  uint64_t have = 0;
+  CHECK(store.begin(id_of(a), a.size(), have) == BlobStore::Put::kPartial);
+  CHECK(have == 1234);
+  CHECK(store.used() == 3000);
+  CHECK(store.put(id_of(a), a.size(), have, std::string_view(a).substr(have)) == BlobStore::Put::kComplete);
+  CHECK(store.used() == 3000);
+}
@@ -0,0 +1,81 @@
+#include "check.hpp"
+#include "util/join_gate.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace lanchat;
+using Clock = std::chrono::steady_clock;
+
+static int64_t ms_since(Clock::time_point t0){
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+}
+
+TEST(join_gate_queue_capped_by_what_drains_in_time){
+  JoinGate gate;
+  gate.configure(/*rate*/10, /*burst*/2, /*queue_max*/512, /*wait_ms*/1000);
+  // За секунду пройдут burst + rate = 12 входов; тринадцатый получает BUSY сразу.
+  for (int i = 0; i < 12; ++i) CHECK(gate.enter());
+  CHECK(!gate.enter());
+  CHECK(gate.queued() == 12);
+  gate.leave();
+  CHECK(gate.enter());
+  for (int i = 0; i < 12; ++i) gate.leave();
+  CHECK(gate.queued() == 0);
+
+  gate.configure(10, 2, /*queue_max*/5, 1000);
+  for (int i = 0; i < 5; ++i) CHECK(gate.enter());
+  CHECK(!gate.enter());
+  for (int i = 0; i < 5; ++i) gate.leave();
+}
+
+TEST(join_gate_token_bucket_paces_admissions){
+  JoinGate gate;
+  gate.configure(/*rate*/20, /*burst*/2, 0, /*wait_ms*/2000);
+  std::atomic<bool> stop{false};
+  const auto t0 = Clock::now();
+  // Запас burst проходит сразу, дальше — по токену раз в 50 мс.
+  for (int i = 0; i < 2; ++i){
+    REQUIRE(gate.enter());
+    CHECK(gate.admit(1000, stop));
+  }
+  CHECK(ms_since(t0) < 40);
+  for (int i = 0; i < 3; ++i){
+    REQUIRE(gate.enter());
+    CHECK(gate.admit(1000, stop));
+  }
+  CHECK(ms_since(t0) >= 140);
+  CHECK(gate.queued() == 0);
+
+  // Токенов нет и ждать нельзя — отказ, место в очереди освобождается.
+  REQUIRE(gate.enter());
+  CHECK(!gate.admit(0, stop));
+  CHECK(gate.queued() == 0);
+}
+
+TEST(join_gate_admits_in_arrival_order){
+  JoinGate gate;
+  gate.configure(/*rate*/50, /*burst*/1, 0, /*wait_ms*/5000);
+  std::atomic<bool> stop{false};
+  REQUIRE(gate.enter());
+  CHECK(gate.admit(1000, stop));   // забрать запас: дальше все ждут
+
+  std::mutex mx;
+  std::vector<int> order;
+  std::vector<std::thread> th;
+  for (int i = 0; i < 6; ++i){
+    REQUIRE(gate.enter());
+    th.emplace_back([&, i]{
+      if (gate.admit(5000, stop)){
+        std::lock_guard<std::mutex> lk(mx);
+        order.push_back(i);
+      }
+    });
+    // Следующий приходит заметно позже, но раньше, чем появится токен.
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+  }
+  for (auto& t : th) t.join();
+  REQUIRE(order.size() == 6);
+  for (int i = 0; i < 6; ++i) CHECK(order[i] == i);
+}
@@ -0,0 +1,35 @@
+#include "check.hpp"
+#include "hash/hash.hpp"
+
+#include <string>
+
+using namespace lanchat;
+
+static std::string sha(const std::string& s){
+  Sha256 h;
+  h.update(s.data(), s.size());
+  return h.hex_final();
+}
+
+// Векторы FIPS 180-2.
+TEST(sha256_known_vectors){
+  CHECK(sha("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  CHECK(sha("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  CHECK(sha("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  CHECK(sha(std::string(1000000, 'a')) ==
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+// BlobStore хэширует кусками произвольной длины: результат не должен зависеть от нарезки.
+TEST(sha256_incremental_matches_one_shot){
+  std::string data;
+  for (int i = 0; i < 5000; ++i) data.push_back(static_cast<char>(i * 31 + 7));
+  const std::string whole = sha(data);
+  for (std::size_t step : {1u, 3u, 55u, 63u, 64u, 65u, 1000u}){
+    Sha256 h;
+    for (std::size_t at = 0; at < data.size(); at += step)
+      h.update(data.data() + at, std::min(step, data.size() - at));
+    CHECK(h.hex_final() == whole);
+  }
+}
@@ -0,0 +1,72 @@
+#include "check.hpp"
+
+#if defined(__linux__)
+
+#include "net/shm_ring.hpp"
+#include "net/wire.hpp"
+
+#include <sys/mman.h>
+
+#include <string>
+
+using namespace lanchat;
+
+// Потребитель так же, как бот: отображает memfd и читает кадры из [tail, head).
+struct Consumer {
+  ShmRingHeader* hdr = nullptr;
+  const char* data = nullptr;
+  std::size_t total = 0;
+
+  explicit Consumer(const ShmRing& ring) : total(kShmHeaderSize + ring.capacity()) {
+    void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, ring.mem_fd(), 0);
+    if (p == MAP_FAILED) return;
+    hdr = static_cast<ShmRingHeader*>(p);
+    data = static_cast<const char*>(p) + kShmHeaderSize;
+  }
+  ~Consumer(){ if (hdr) munmap(hdr, total); }
+
+  std::string read(std::size_t n){
+    const uint64_t cap = hdr->capacity;
+    uint64_t tail = hdr->tail.load();
+    std::string out(n, '\0');
+    for (std::size_t i = 0; i < n; ++i) out[i] = data[(tail + i) % cap];
+    hdr->tail.store(tail + n);
+    return out;
+  }
+};
+
+TEST(shm_ring_frames_wrap_around_the_end){
+  auto ring = ShmRing::create(256);
+  REQUIRE(ring);
+  Consumer c(*ring);
+  REQUIRE(c.hdr);
+  CHECK(c.hdr->magic == kShmMagic);
+
+  // 100-байтовые кадры в кольце на 256 байт: третий и дальше переходят через край.
+  for (int i = 0; i < 20; ++i){
+    const std::string payload(95, static_cast<char>('a' + i));
+    REQUIRE(ring->push_frame(0x12, payload, 0));
+    CHECK(c.hdr->head.load() - c.hdr->tail.load() == 100);
+    const std::string got = c.read(100);
+    const auto h = wire::parse_header(reinterpret_cast<const uint8_t*>(got.data()));
+    CHECK(h.type == 0x12);
+    CHECK(h.len == 95);
+    CHECK(got.substr(wire::kHeaderSize) == payload);
+  }
+  CHECK(c.hdr->head.load() == 2000);
+}
+
+TEST(shm_ring_refuses_when_consumer_lags){
+  auto ring = ShmRing::create(256);
+  REQUIRE(ring);
+  Consumer c(*ring);
+  REQUIRE(c.hdr);
+  const std::string payload(95, 'z');
+  CHECK(ring->push_frame(0x12, payload, 0));
+  CHECK(ring->push_frame(0x12, payload, 0));
+  CHECK(!ring->push_frame(0x12, payload, 0));   // места на третий нет, ждать нельзя
+  c.read(100);
+  CHECK(ring->push_frame(0x12, payload, 0));
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "check.hpp"
+#include "storage/storage.hpp"
+#include "util/work_pool.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace lanchat;
+
+// Строки кодируются в пуле и готовы не по порядку; в лог, в since() и в
+// рассылку они должны попадать строго по seq, а недописанный seq — задерживать
+// всё, что за ним.
+TEST(storage_since_skips_in_flight_seqs){
+  test::TempDir dir("storage_since");
+  UserRegistry users;
+  REQUIRE(users.open(dir.str()));
+  Storage storage(100, users);
+  REQUIRE(storage.open(dir.str()));
+  storage.enable_encryption(std::vector<uint8_t>(32, 0xab));
+  WorkPool pool(3);
+  pool.start();
+  storage.set_pool(&pool);
+
+  std::mutex mx;
+  std::vector<uint64_t> committed;
+  storage.set_on_commit([&](const Message& m, uint64_t){
+    std::lock_guard<std::mutex> lk(mx);
+    committed.push_back(m.seq);
+  });
+
+  std::mutex gate_mx;
+  std::condition_variable gate_cv;
+  bool open = false;
+  const uint32_t uid = users.intern("alice");
+  for (int i = 0; i < 5; ++i){
+    Message m;
+    m.ts_ms = 1000 + i;
+    m.user_id = uid;
+    m.text = "m" + std::to_string(i);
+    // Второе сообщение (seq 2) задерживается в пуле, остальные готовы сразу.
+    storage.append(m, [&, i](Message&){
+      if (i != 1) return;
+      std::unique_lock<std::mutex> lk(gate_mx);
+      gate_cv.wait(lk, [&]{ return open; });
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::vector<Message> out;
+  CHECK(storage.since(0, 10, out));
+  REQUIRE(out.size() == 1);
+  CHECK(out[0].seq == 1);
+  // seq 2 ещё не записан: "после 2" — не пустой ответ, а отказ (клиент обгоняет лог).
+  CHECK(!storage.since(2, 10, out));
+  {
+    std::lock_guard<std::mutex> lk(mx);
+    CHECK(committed == std::vector<uint64_t>({1}));
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(gate_mx);
+    open = true;
+  }
+  gate_cv.notify_all();
+  storage.drain();
+
+  out.clear();
+  CHECK(storage.since(0, 10, out));
+  REQUIRE(out.size() == 5);
+  for (std::size_t i = 0; i < out.size(); ++i){
+    CHECK(out[i].seq == i + 1);
+    CHECK(out[i].text == "m" + std::to_string(i));
+  }
+  std::lock_guard<std::mutex> lk(mx);
+  CHECK(committed == std::vector<uint64_t>({1, 2, 3, 4, 5}));
+  pool.stop();
+}
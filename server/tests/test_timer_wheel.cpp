@@ -0,0 +1,53 @@
+#include "check.hpp"
+#include "util/timer_wheel.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace lanchat;
+using Clock = std::chrono::steady_clock;
+
+// Таймеры дальше 64 тиков лежат на верхних уровнях и переезжают вниз при
+// каскаде: срабатывать они должны не раньше срока и в порядке сроков.
+TEST(timer_wheel_cascade_keeps_order_and_deadlines){
+  TimerWheel wheel(/*tick_ms*/1);
+  wheel.start();
+  const auto t0 = Clock::now();
+  std::mutex mx;
+  std::vector<std::pair<uint32_t, int64_t>> fired;   // задержка, фактическое время
+  const uint32_t delays[] = {300, 5, 130, 70, 64, 65};
+  for (uint32_t d : delays){
+    wheel.schedule(d, [&, d]{
+      const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t0).count();
+      std::lock_guard<std::mutex> lk(mx);
+      fired.emplace_back(d, ms);
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  wheel.stop();
+
+  std::lock_guard<std::mutex> lk(mx);
+  REQUIRE(fired.size() == 6);
+  for (std::size_t i = 0; i < fired.size(); ++i){
+    CHECK(fired[i].second >= static_cast<int64_t>(fired[i].first));
+    if (i) CHECK(fired[i - 1].first <= fired[i].first);
+  }
+  CHECK(wheel.size() == 0);
+}
+
+TEST(timer_wheel_cancel){
+  TimerWheel wheel(/*tick_ms*/1);
+  wheel.start();
+  std::atomic<int> hits{0};
+  const auto near = wheel.schedule(20, [&]{ ++hits; });
+  const auto far = wheel.schedule(150, [&]{ hits += 100; });   // уже на втором уровне
+  wheel.schedule(30, [&]{ hits += 10; });
+  CHECK(wheel.cancel(near));
+  CHECK(wheel.cancel(far));
+  CHECK(!wheel.cancel(far));
+  std::this_thread::sleep_for(std::chrono::milliseconds(250));
+  wheel.stop();
+  CHECK(hits.load() == 10);
+}
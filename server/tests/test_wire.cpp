@@ -0,0 +1,65 @@
+#include "check.hpp"
+#include "net/protocol.hpp"
+
+#include <string>
+
+using namespace lanchat;
+
+TEST(wire_broadcast_round_trip){
+  const std::string payload = BroadcastFrame::encode(1234567890123ull, "alice", "hello", 42);
+  CHECK(payload.size() == BroadcastFrame::size(1234567890123ull, "alice", "hello", 42));
+  BroadcastFrame::View v;
+  REQUIRE(BroadcastFrame::decode(payload, v));
+  CHECK(std::get<0>(v) == 1234567890123ull);
+  CHECK(std::get<1>(v) == "alice");
+  CHECK(std::get<2>(v) == "hello");
+  CHECK(std::get<3>(v) == 42);
+}
+
+TEST(wire_optional_tail_absent_reads_zero){
+  // seq 0 не пишется: такой кадр совпадает с кадром старого сервера без seq.
+  const std::string payload = BroadcastFrame::encode(1, "bob", "x", 0);
+  CHECK(payload.size() == BroadcastFrame::kMinSize + 3 + 1);
+  BroadcastFrame::View v;
+  REQUIRE(BroadcastFrame::decode(payload, v));
+  CHECK(std::get<3>(v) == 0);
+}
+
+TEST(wire_append_writes_header){
+  std::string out = "prefix";
+  REQUIRE(HistoryEndFrame::append(out, 7, 99));
+  REQUIRE(out.size() == 6 + wire::kHeaderSize + HistoryEndFrame::kMinSize);
+  const auto h = wire::parse_header(reinterpret_cast<const uint8_t*>(out.data() + 6));
+  CHECK(h.type == HISTORY_END);
+  CHECK(h.len == HistoryEndFrame::kMinSize);
+  HistoryEndFrame::View v;
+  REQUIRE(HistoryEndFrame::decode(std::string_view(out).substr(6 + wire::kHeaderSize), v));
+  CHECK(std::get<0>(v) == 7);
+  CHECK(std::get<1>(v) == 99);
+}
+
+TEST(wire_rejects_truncated_and_lying_payloads){
+  const std::string payload = BroadcastFrame::encode(5, "carol", "text", 9);
+  BroadcastFrame::View v;
+  for (std::size_t n = 0; n < BroadcastFrame::kMinSize; ++n)
+    CHECK(!BroadcastFrame::decode(std::string_view(payload).substr(0, n), v));
+  // Обрезан внутри текста: длина в префиксе Bytes32 больше оставшихся байт.
+  const std::string no_seq = BroadcastFrame::encode(5, "carol", "text", 0);
+  CHECK(!BroadcastFrame::decode(std::string_view(no_seq).substr(0, no_seq.size() - 2), v));
+
+  std::string lying = AttachBeginFrame::encode("id", 10);
+  lying[1] = 100;   // Str16: длина 100 при двух байтах строки
+  AttachBeginFrame::View a;
+  CHECK(!AttachBeginFrame::decode(lying, a));
+}
+
+TEST(wire_oversize_field_is_refused_without_touching_out){
+  const std::string big(70000, 'a');   // длиннее префикса Str16
+  std::string out = "keep";
+  CHECK(!PeerHelloFrame::append(out, big, "token"));
+  CHECK(!PeerHelloFrame::encode_to(out, big, "token"));
+  CHECK(out == "keep");
+  CHECK(PeerHelloFrame::encode(big, "token").empty());
+  CHECK(!PeerHelloFrame::fits(big, "token"));
+  CHECK(PeerHelloFrame::fits(std::string(65535, 'a'), "token"));
+}
@@ -0,0 +1,45 @@
+#include "check.hpp"
+#include "util/work_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace lanchat;
+
+TEST(work_pool_runs_every_task){
+  WorkPool pool(4);
+  pool.start();
+  std::atomic<int> done{0};
+  for (int i = 0; i < 10000; ++i) pool.submit([&]{ ++done; });
+  // Задача из потока пула идёт в его очередь, и её тоже кто-то выполнит.
+  for (int i = 0; i < 100; ++i) pool.submit([&]{ pool.submit([&]{ ++done; }); });
+  pool.stop();
+  CHECK(done.load() == 10100);
+  CHECK(pool.pending() == 0);
+}
+
+// Задача, поставленная параллельно со stop(), не теряется: либо её выполнит
+// пул, либо она выполнится на месте.
+TEST(work_pool_submit_racing_stop_loses_nothing){
+  for (int round = 0; round < 100; ++round){
+    WorkPool pool(3);
+    pool.start();
+    std::atomic<int> done{0};
+    std::vector<std::thread> th;
+    for (int t = 0; t < 4; ++t)
+      th.emplace_back([&]{ for (int i = 0; i < 250; ++i) pool.submit([&]{ ++done; }); });
+    std::this_thread::sleep_for(std::chrono::microseconds(round * 10));
+    pool.stop();
+    for (auto& t : th) t.join();
+    CHECK(done.load() == 1000);
+  }
+}
+
+TEST(work_pool_inline_when_stopped){
+  WorkPool pool(2);
+  int done = 0;
+  pool.submit([&]{ ++done; });   // пул не запущен — на месте
+  CHECK(done == 1);
+}